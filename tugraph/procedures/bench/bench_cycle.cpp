@@ -0,0 +1,155 @@
+/**
+ * Copyright 2022 AntGroup CO., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ */
+
+/*
+ * Latency of the tcycle plugin per cycle length: for the transfers of
+ * AddAccountTransferAccountWrite12, asks whether fromId -> toId would close a cycle of k edges
+ * within the window ending at its createTime, for k = 3..6, with and without ascending
+ * timestamps. Read-only, so the imported database can be used as is.
+ *
+ * Before timing, FindCycle is checked on small in-memory graphs where a closed walk exists but no
+ * simple cycle of the asked length does (mutual transfers, a 3-cycle asked as k=6); exits
+ * non-zero if it reports one.
+ *
+ * usage: ./bench_cycle db_dir incremental_dir plugin_dir [pairs] [window_ms] [limit]
+ */
+
+#include <dlfcn.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "finbench_plugin.h"
+#include "lgraph/lgraph.h"
+#include "tools/json.hpp"
+
+using json = nlohmann::json;
+typedef bool (*ProcessFunc)(lgraph_api::GraphDB&, const std::string&, std::string&);
+
+static ProcessFunc LoadPlugin(const std::string& dir, const std::string& name) {
+    void* handle = dlopen((dir + "/" + name + ".so").c_str(), RTLD_NOW);
+    if (!handle) {
+        std::fprintf(stderr, "%s\n", dlerror());
+        std::exit(1);
+    }
+    return reinterpret_cast<ProcessFunc>(dlsym(handle, "Process"));
+}
+
+// fromId -> toId would close a cycle of K edges over `edges` (from, to, ts)
+template <size_t K>
+static bool Closes(const std::vector<std::tuple<int64_t, int64_t, int64_t>>& edges,
+                   int64_t from_id, int64_t to_id, bool ascending, bool reversed) {
+    auto expand = [&](int64_t vid, bool out, auto&& visit) {
+        for (auto& e : edges) {
+            if (std::get<0>(e) == vid && out) visit(std::get<1>(e), std::get<2>(e));
+            if (std::get<1>(e) == vid && !out) visit(std::get<0>(e), std::get<2>(e));
+        }
+    };
+    return FindCycle<K>(from_id, to_id, ascending, expand, reversed);
+}
+
+static void SelfCheck() {
+    // 1 <-> 2 only: closed walks 2 -> 1 -> 2 -> 1, never 4 distinct accounts
+    std::vector<std::tuple<int64_t, int64_t, int64_t>> mutual = {{2, 1, 1}, {1, 2, 2}, {2, 1, 3}};
+    // 2 -> 3 -> 1 closes a 3-cycle; k=6 would have to walk it twice
+    std::vector<std::tuple<int64_t, int64_t, int64_t>> triangle = {
+        {2, 3, 1}, {3, 1, 2}, {1, 2, 3}, {2, 3, 4}, {3, 1, 5}};
+    // 2 -> 3 -> 4 -> 1 is a real 4-cycle
+    std::vector<std::tuple<int64_t, int64_t, int64_t>> square = {{2, 3, 1}, {3, 4, 2}, {4, 1, 3}};
+    bool ok = true;
+    for (bool ascending : {false, true}) {
+        for (bool reversed : {false, true}) {
+            ok &= !Closes<4>(mutual, 1, 2, ascending, reversed);
+            ok &= !Closes<6>(mutual, 1, 2, ascending, reversed);
+            ok &= !Closes<6>(triangle, 1, 2, ascending, reversed);
+            ok &= Closes<3>(triangle, 1, 2, ascending, reversed);
+            ok &= Closes<4>(square, 1, 2, ascending, reversed);
+            ok &= !Closes<5>(square, 1, 2, ascending, reversed);
+        }
+    }
+    if (!ok) {
+        std::fprintf(stderr, "FindCycle self-check failed\n");
+        std::exit(1);
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        std::fprintf(stderr,
+                     "usage: %s db_dir incremental_dir plugin_dir [pairs] [window_ms] [limit]\n",
+                     argv[0]);
+        return 1;
+    }
+    SelfCheck();
+    std::string db_dir = argv[1], inc_dir = argv[2], plugin_dir = argv[3];
+    size_t pairs = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 1000;
+    int64_t window = argc > 5 ? std::strtoll(argv[5], nullptr, 10) : 30LL * 24 * 3600 * 1000;
+    int64_t limit = argc > 6 ? std::strtoll(argv[6], nullptr, 10) : -1;
+
+    // createTime|dependencyTime|fromId|toId|amount|...
+    std::vector<std::tuple<int64_t, int64_t, int64_t>> transfers;
+    std::ifstream in(inc_dir + "/AddAccountTransferAccountWrite12.csv");
+    std::string line;
+    std::getline(in, line);
+    while (transfers.size() < pairs && std::getline(in, line)) {
+        std::vector<std::string> row;
+        std::stringstream ss(line);
+        std::string cell;
+        while (std::getline(ss, cell, '|')) row.push_back(cell);
+        transfers.emplace_back(std::stoll(row[0]), std::stoll(row[2]), std::stoll(row[3]));
+    }
+
+    lgraph_api::Galaxy galaxy(db_dir, false, true);
+    galaxy.SetCurrentUser("admin", "73@TuGraph");
+    lgraph_api::GraphDB db = galaxy.OpenGraph("default");
+    ProcessFunc tcycle = LoadPlugin(plugin_dir, "tcycle");
+
+    std::printf("pairs %zu, window %ld ms, limit %ld\n", transfers.size(), (long)window,
+                (long)limit);
+    std::string response;
+    for (bool ascending : {false, true}) {
+        for (int k = 3; k <= 6; k++) {
+            std::vector<double> us;
+            size_t found = 0;
+            for (auto& t : transfers) {
+                json req = {{"srcId", std::get<1>(t)},
+                            {"dstId", std::get<2>(t)},
+                            {"k", k},
+                            {"startTime", std::get<0>(t) - window},
+                            {"endTime", std::get<0>(t)},
+                            {"limit", limit},
+                            {"ascending", ascending}};
+                auto begin = std::chrono::steady_clock::now();
+                tcycle(db, req.dump(), response);
+                auto end = std::chrono::steady_clock::now();
+                us.push_back(std::chrono::duration<double, std::micro>(end - begin).count());
+                if (json::parse(response)[0]["found"].get<bool>()) found++;
+            }
+            if (us.empty()) continue;
+            std::sort(us.begin(), us.end());
+            double sum = 0;
+            for (double x : us) sum += x;
+            std::printf("k=%d %-10s found %6zu  mean %10.1f us  p50 %10.1f us  p99 %10.1f us\n",
+                        k, ascending ? "ascending" : "any", found, sum / us.size(),
+                        us[us.size() / 2], us[us.size() * 99 / 100]);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,186 @@
+/**
+ * Copyright 2022 AntGroup CO., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ */
+
+/*
+ * Replays AddLoanDepositAccountWrite15 and AddAccountTransferAccountWrite12 in createTime order
+ * through the tw15/tw12 plugins and, after every batch of writes, re-runs tcr8 for the hottest
+ * loans with and without materialize. Reports per-call latency of both modes and the number of
+ * calls whose (id, distance) sets disagree, which should be 0. Ratios are not compared, as the
+ * amounts may be summed in another order.
+ *
+ * The writes are committed, so point it at a scratch copy of the imported database.
+ *
+ * usage: ./bench_tcr8_incremental db_dir incremental_dir plugin_dir [batch] [hot_loans] [limit]
+ */
+
+#include <dlfcn.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "lgraph/lgraph.h"
+#include "tools/json.hpp"
+
+using json = nlohmann::json;
+typedef bool (*ProcessFunc)(lgraph_api::GraphDB&, const std::string&, std::string&);
+
+struct WriteOp {
+    int64_t time;
+    bool deposit;
+    int64_t src, dst;
+    double amount;
+};
+
+static ProcessFunc LoadPlugin(const std::string& dir, const std::string& name) {
+    void* handle = dlopen((dir + "/" + name + ".so").c_str(), RTLD_NOW);
+    if (!handle) {
+        std::fprintf(stderr, "%s\n", dlerror());
+        std::exit(1);
+    }
+    return reinterpret_cast<ProcessFunc>(dlsym(handle, "Process"));
+}
+
+// rows of a '|' separated file with a header line
+static std::vector<std::vector<std::string>> ReadCsv(const std::string& path) {
+    std::vector<std::vector<std::string>> rows;
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    while (std::getline(in, line)) {
+        std::vector<std::string> row;
+        std::stringstream ss(line);
+        std::string cell;
+        while (std::getline(ss, cell, '|')) row.push_back(cell);
+        rows.push_back(std::move(row));
+    }
+    return rows;
+}
+
+static std::set<std::pair<int64_t, int64_t>> Reached(const std::string& response) {
+    std::set<std::pair<int64_t, int64_t>> reached;
+    for (auto& r : json::parse(response)) reached.emplace(r["i"], r["d"]);
+    return reached;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        std::fprintf(stderr,
+                     "usage: %s db_dir incremental_dir plugin_dir [batch] [hot_loans] [limit]\n",
+                     argv[0]);
+        return 1;
+    }
+    std::string db_dir = argv[1], inc_dir = argv[2], plugin_dir = argv[3];
+    size_t batch = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 16;
+    size_t hot_loans = argc > 5 ? std::strtoull(argv[5], nullptr, 10) : 8;
+    int64_t limit = argc > 6 ? std::strtoll(argv[6], nullptr, 10) : -1;
+
+    std::vector<WriteOp> ops;
+    std::unordered_map<int64_t, size_t> deposits_per_loan;
+    for (auto& row : ReadCsv(inc_dir + "/AddLoanDepositAccountWrite15.csv")) {
+        // createTime|dependencyTime|accountId|loanId|amount
+        int64_t loan = std::stoll(row[3]);
+        ops.push_back({std::stoll(row[0]), true, loan, std::stoll(row[2]), std::stod(row[4])});
+        deposits_per_loan[loan]++;
+    }
+    for (auto& row : ReadCsv(inc_dir + "/AddAccountTransferAccountWrite12.csv")) {
+        // createTime|dependencyTime|fromId|toId|amount|...
+        ops.push_back({std::stoll(row[0]), false, std::stoll(row[2]), std::stoll(row[3]),
+                       std::stod(row[4])});
+    }
+    std::stable_sort(ops.begin(), ops.end(),
+                     [](const WriteOp& a, const WriteOp& b) { return a.time < b.time; });
+    std::vector<std::pair<size_t, int64_t>> by_deposits;
+    for (auto& kv : deposits_per_loan) by_deposits.emplace_back(kv.second, kv.first);
+    std::sort(by_deposits.rbegin(), by_deposits.rend());
+    std::vector<int64_t> loans;
+    for (size_t i = 0; i < by_deposits.size() && i < hot_loans; i++) {
+        loans.push_back(by_deposits[i].second);
+    }
+
+    lgraph_api::Galaxy galaxy(db_dir, false, true);
+    galaxy.SetCurrentUser("admin", "73@TuGraph");
+    lgraph_api::GraphDB db = galaxy.OpenGraph("default");
+    ProcessFunc tcr8 = LoadPlugin(plugin_dir, "tcr8");
+    ProcessFunc tw12 = LoadPlugin(plugin_dir, "tw12");
+    ProcessFunc tw15 = LoadPlugin(plugin_dir, "tw15");
+
+    // the window covers the replayed writes, so every deposit and transfer is a delta
+    const int64_t start_time = 0, end_time = INT64_MAX;
+    auto tcr8_request = [&](int64_t loan, bool materialize) {
+        json req = {{"id", loan},          {"threshold", 0.0},     {"startTime", start_time},
+                    {"endTime", end_time}, {"limit", limit}, {"materialize", materialize}};
+        return req.dump();
+    };
+    auto time_call = [&](ProcessFunc f, const std::string& request, std::string& response) {
+        auto begin = std::chrono::steady_clock::now();
+        f(db, request, response);
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::micro>(end - begin).count();
+    };
+
+    std::string response, expected;
+    // warm both modes so the first materialized call pays the full computation outside the loop
+    for (int64_t loan : loans) {
+        tcr8(db, tcr8_request(loan, true), response);
+        tcr8(db, tcr8_request(loan, false), response);
+    }
+    std::vector<double> full_us, incr_us;
+    double write_us = 0;
+    size_t mismatches = 0;
+    for (size_t begin = 0; begin < ops.size(); begin += batch) {
+        for (size_t i = begin; i < ops.size() && i < begin + batch; i++) {
+            const WriteOp& op = ops[i];
+            json req = {{"time", op.time}, {"amt", op.amount}};
+            if (op.deposit) {
+                req["loanId"] = op.src;
+                req["accountId"] = op.dst;
+                write_us += time_call(tw15, req.dump(), response);
+            } else {
+                req["srcId"] = op.src;
+                req["dstId"] = op.dst;
+                write_us += time_call(tw12, req.dump(), response);
+            }
+        }
+        for (int64_t loan : loans) {
+            full_us.push_back(time_call(tcr8, tcr8_request(loan, false), expected));
+            incr_us.push_back(time_call(tcr8, tcr8_request(loan, true), response));
+            if (Reached(expected) != Reached(response)) mismatches++;
+        }
+    }
+
+    auto report = [](const char* name, std::vector<double>& us) {
+        if (us.empty()) return;
+        std::sort(us.begin(), us.end());
+        double sum = 0;
+        for (double x : us) sum += x;
+        std::printf("%-12s calls %8zu  mean %10.1f us  p50 %10.1f us  p99 %10.1f us\n", name,
+                    us.size(), sum / us.size(), us[us.size() / 2], us[us.size() * 99 / 100]);
+    };
+    std::printf("writes %zu (%.1f us each), hot loans %zu, batch %zu\n", ops.size(),
+                ops.empty() ? 0.0 : write_us / ops.size(), loans.size(), batch);
+    report("full", full_us);
+    report("incremental", incr_us);
+    std::printf("mismatches %zu\n", mismatches);
+    return 0;
+}
@@ -0,0 +1,103 @@
+/**
+ * Copyright 2022 AntGroup CO., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ */
+
+/*
+ * Microbenchmark of the window kernels behind AdjacencyColumns: filter, count and sum of the
+ * edges with start < ts < end and amount > min over synthetic adjacency columns of 16 to 64k
+ * edges, about half of them in the window.
+ *
+ * usage: ./bench_window [rounds]
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "finbench_simd.h"
+
+template <typename F>
+static double TimeNs(F&& f, size_t rounds, double& sink) {
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < rounds; r++) {
+        // keep the compiler from hoisting the loop-invariant kernel out of the loop
+        asm volatile("" ::: "memory");
+        sink += f();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - begin).count() / rounds;
+}
+
+int main(int argc, char** argv) {
+    size_t rounds = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200;
+    std::mt19937_64 rng(42);
+    double sink = 0;
+    bool has_avx2 = false;
+#ifdef FINBENCH_HAS_AVX2_PATH
+    has_avx2 = __builtin_cpu_supports("avx2");
+#endif
+    std::printf("%8s %6s %12s %12s\n", "edges", "kernel", "scalar(ns)", "avx2(ns)");
+    for (size_t n : {16, 256, 4096, 65536}) {
+        // newest first, like a cached label
+        std::vector<int64_t> ts(n);
+        std::vector<double> amount(n);
+        for (size_t i = 0; i < n; i++) {
+            ts[i] = static_cast<int64_t>(n - i) * 1000;
+            amount[i] = static_cast<double>(rng() % 100000) / 100;
+        }
+        std::vector<uint32_t> out(n);
+        const int64_t start = static_cast<int64_t>(n) * 250, end = static_cast<int64_t>(n) * 750;
+        const double min_amount = 500;
+        size_t rs = std::max<size_t>(1, rounds * 10000 / n);
+        auto row = [&](const char* name, auto&& scalar, auto&& avx2) {
+            double t_scalar = TimeNs(scalar, rs, sink);
+            double t_avx2 = has_avx2 ? TimeNs(avx2, rs, sink) : -1;
+            if (has_avx2 && std::fabs(scalar() - avx2()) > 1e-6 * std::fabs(scalar())) {
+                std::fprintf(stderr, "avx2/scalar mismatch in %s at %zu edges\n", name, n);
+                std::exit(1);
+            }
+            std::printf("%8zu %6s %12.1f %12.1f\n", n, name, t_scalar, t_avx2);
+        };
+#ifdef FINBENCH_HAS_AVX2_PATH
+        row("filter",
+            [&]() {
+                return (double)FilterWindowScalar(ts.data(), amount.data(), n, start, end,
+                                                  min_amount, out.data());
+            },
+            [&]() {
+                return (double)FilterWindowAvx2(ts.data(), amount.data(), n, start, end,
+                                                min_amount, out.data());
+            });
+        row("count",
+            [&]() {
+                return (double)CountWindowScalar(ts.data(), amount.data(), n, start, end,
+                                                 min_amount);
+            },
+            [&]() {
+                return (double)CountWindowAvx2(ts.data(), amount.data(), n, start, end,
+                                               min_amount);
+            });
+        row("sum",
+            [&]() { return SumWindowScalar(ts.data(), amount.data(), n, start, end, min_amount); },
+            [&]() { return SumWindowAvx2(ts.data(), amount.data(), n, start, end, min_amount); });
+#else
+        auto scalar_only = [&]() {
+            return (double)CountWindowScalar(ts.data(), amount.data(), n, start, end, min_amount);
+        };
+        row("count", scalar_only, scalar_only);
+#endif
+    }
+    return sink == 0 ? 1 : 0;
+}
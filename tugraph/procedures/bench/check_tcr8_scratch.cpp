@@ -0,0 +1,142 @@
+/**
+ * Copyright 2022 AntGroup CO., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ */
+
+/*
+ * Checks the tcr8 scratch cap on a synthetic high fan-out loan: the first loan of the database
+ * gets `fanout` deposits through tw15, and every deposited account `fanout` transfers through
+ * tw12. tcr8 is then called without a cap, and with maxScratchBytes = cap, plain and
+ * materialized. The capped calls must return fewer rows than the uncapped one, all of them marked
+ * truncated and among the uncapped rows, and a materialized call after a truncated one must return
+ * the full, untruncated result.
+ * Exits non-zero on the first failed check.
+ *
+ * The writes are committed, so point it at a scratch copy of the imported database.
+ *
+ * usage: ./check_tcr8_scratch db_dir plugin_dir [fanout] [cap]
+ */
+
+#include <dlfcn.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <string>
+#include <vector>
+#include "lgraph/lgraph.h"
+#include "tools/json.hpp"
+
+using json = nlohmann::json;
+typedef bool (*ProcessFunc)(lgraph_api::GraphDB&, const std::string&, std::string&);
+
+static ProcessFunc LoadPlugin(const std::string& dir, const std::string& name) {
+    void* handle = dlopen((dir + "/" + name + ".so").c_str(), RTLD_NOW);
+    if (!handle) {
+        std::fprintf(stderr, "%s\n", dlerror());
+        std::exit(1);
+    }
+    return reinterpret_cast<ProcessFunc>(dlsym(handle, "Process"));
+}
+
+static void Check(bool ok, const char* what, const std::string& response) {
+    if (ok) return;
+    std::fprintf(stderr, "FAILED: %s\nresponse: %.512s\n", what, response.c_str());
+    std::exit(1);
+}
+
+static std::set<int64_t> Ids(const json& rows) {
+    std::set<int64_t> ids;
+    for (auto& r : rows) ids.insert(r["i"].get<int64_t>());
+    return ids;
+}
+
+// whether every row has the "truncated" column set to `truncated`
+static bool AllTruncated(const json& rows, bool truncated) {
+    for (auto& r : rows) {
+        if (r.value("truncated", !truncated) != truncated) return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::fprintf(stderr, "usage: %s db_dir plugin_dir [fanout] [cap]\n", argv[0]);
+        return 1;
+    }
+    std::string db_dir = argv[1], plugin_dir = argv[2];
+    size_t fanout = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 256;
+    int64_t cap = argc > 4 ? std::strtoll(argv[4], nullptr, 10) : 64 << 10;
+
+    lgraph_api::Galaxy galaxy(db_dir, false, true);
+    galaxy.SetCurrentUser("admin", "73@TuGraph");
+    lgraph_api::GraphDB db = galaxy.OpenGraph("default");
+    ProcessFunc tcr8 = LoadPlugin(plugin_dir, "tcr8");
+    ProcessFunc tw12 = LoadPlugin(plugin_dir, "tw12");
+    ProcessFunc tw15 = LoadPlugin(plugin_dir, "tw15");
+
+    int64_t loan = -1;
+    std::vector<int64_t> accounts;
+    {
+        auto txn = db.CreateReadTxn();
+        for (auto vit = txn.GetVertexIterator(); vit.IsValid(); vit.Next()) {
+            const std::string label = vit.GetLabel();
+            if (label == "Loan" && loan < 0) {
+                loan = vit.GetField("id").AsInt64();
+            } else if (label == "Account" && accounts.size() < fanout * 2) {
+                accounts.push_back(vit.GetField("id").AsInt64());
+            }
+            if (loan >= 0 && accounts.size() == fanout * 2) break;
+        }
+    }
+    Check(loan >= 0 && accounts.size() == fanout * 2, "not enough loans and accounts", "");
+
+    // loan -> accounts[0, fanout) -> accounts[fanout, 2 * fanout), every pair
+    std::string response;
+    int64_t time = 1;
+    for (size_t i = 0; i < fanout; i++) {
+        json req = {{"loanId", loan}, {"accountId", accounts[i]}, {"time", time++}, {"amt", 1e6}};
+        Check(tw15(db, req.dump(), response), "tw15", response);
+        for (size_t j = fanout; j < fanout * 2; j++) {
+            json req = {{"srcId", accounts[i]}, {"dstId", accounts[j]}, {"time", time++},
+                        {"amt", 1.0}};
+            Check(tw12(db, req.dump(), response), "tw12", response);
+        }
+    }
+
+    auto call = [&](int64_t max_scratch, bool materialize) {
+        json req = {{"id", loan},        {"threshold", 0.0},        {"startTime", 0},
+                    {"endTime", INT64_MAX}, {"limit", -1},          {"materialize", materialize},
+                    {"maxScratchBytes", max_scratch}};
+        Check(tcr8(db, req.dump(), response), "tcr8", response);
+        return json::parse(response);
+    };
+    json full = call(-1, false);
+    Check(full.is_array() && full.size() >= fanout, "uncapped rows", response);
+    Check(AllTruncated(full, false), "uncapped rows not truncated", response);
+    std::set<int64_t> full_ids = Ids(full);
+    for (bool materialize : {false, true}) {
+        json capped = call(cap, materialize);
+        Check(capped.is_array() && capped.size() < full.size(), "fewer capped rows", response);
+        Check(AllTruncated(capped, true), "capped rows truncated", response);
+        for (int64_t id : Ids(capped)) {
+            Check(full_ids.count(id) != 0, "capped rows within uncapped rows", response);
+        }
+        std::printf("materialize %d: %zu of %zu rows under %lld bytes\n", materialize,
+                    capped.size(), full.size(), (long long)cap);
+    }
+    json again = call(-1, true);
+    Check(again.is_array() && Ids(again) == full_ids && AllTruncated(again, false),
+          "full result after truncation", response);
+    std::printf("ok\n");
+    return 0;
+}
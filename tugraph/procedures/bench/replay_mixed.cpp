@@ -0,0 +1,321 @@
+/**
+ * Copyright 2022 AntGroup CO., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ */
+
+/*
+ * Replays a mixed read/write workload on the embedded database, to measure write contention on
+ * the trw plugins without the Java driver. The incremental streams below are merged in createTime
+ * order, and after every write `reads_per_write` tcr8 calls are interleaved (fractions accumulate)
+ * on loans of the database, with the window ending at the write's time. `threads` workers take
+ * the operations in that order from a shared cursor, so neighbouring writes overlap as they do
+ * under the driver; dependencyTime is not waited for.
+ *
+ *   AddAccountTransferAccountReadWrite1.csv  trw1
+ *   AddAccountTransferAccountReadWrite2.csv  trw2
+ *   AddPersonGuaranteePersonReadWrite3.csv   trw3
+ *   AddAccountTransferAccountWrite12.csv     tw12
+ *   AddPersonGuaranteePersonWrite10.csv      a guarantee edge, added here as the driver does
+ *                                            through Cypher
+ *
+ * Missing files are skipped, and columns are found by their header names. `max_ops` caps the
+ * number of operations replayed (-1 for all); `limit` is the truncation limit of the tcr8 calls
+ * (-1 for none), while the trw calls keep the one of their row. The plugins do not open
+ * optimistic transactions, so a call is never retried: one that throws counts as an error. Reports
+ * throughput, latency per operation, errors and failures (calls that returned false), and the
+ * msg/txn outcomes of the trw calls, which include the blocked accounts.
+ *
+ * The writes are committed, so point it at a scratch copy of the imported database. With db_dir
+ * "-" the streams are only parsed and the resulting requests printed.
+ *
+ * usage: ./replay_mixed db_dir incremental_dir plugin_dir [threads] [reads_per_write] [max_ops]
+ *        [limit]
+ */
+
+#include <dlfcn.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <initializer_list>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "lgraph/lgraph.h"
+#include "tools/json.hpp"
+
+using json = nlohmann::json;
+typedef bool (*ProcessFunc)(lgraph_api::GraphDB&, const std::string&, std::string&);
+
+enum OpKind { kTrw1, kTrw2, kTrw3, kTw12, kWrite10, kTcr8, kNumKinds };
+static const char* KIND_NAMES[kNumKinds] = {"trw1", "trw2", "trw3", "tw12", "write10", "tcr8"};
+
+struct Op {
+    int64_t time;
+    OpKind kind;
+    // the plugin request, or for write10 the two person ids
+    std::string request;
+    int64_t src, dst;
+};
+
+static ProcessFunc LoadPlugin(const std::string& dir, const std::string& name) {
+    void* handle = dlopen((dir + "/" + name + ".so").c_str(), RTLD_NOW);
+    if (!handle) {
+        std::fprintf(stderr, "%s\n", dlerror());
+        std::exit(1);
+    }
+    return reinterpret_cast<ProcessFunc>(dlsym(handle, "Process"));
+}
+
+// a '|' separated file with a header line; empty if the file is missing
+struct Csv {
+    std::vector<std::string> header;
+    std::vector<std::vector<std::string>> rows;
+
+    explicit Csv(const std::string& path) {
+        std::ifstream in(path);
+        std::string line;
+        if (!std::getline(in, line)) return;
+        header = Split(line);
+        while (std::getline(in, line)) rows.push_back(Split(line));
+    }
+
+    // index of the first of `names` in the header, or npos
+    size_t Find(std::initializer_list<const char*> names) const {
+        for (const char* name : names) {
+            auto it = std::find(header.begin(), header.end(), name);
+            if (it != header.end()) return it - header.begin();
+        }
+        return std::string::npos;
+    }
+
+    // as Find, for a column the stream must have
+    size_t Col(std::initializer_list<const char*> names) const {
+        size_t col = Find(names);
+        if (col != std::string::npos) return col;
+        std::fprintf(stderr, "no column %s\n", *names.begin());
+        std::exit(1);
+    }
+
+    static std::vector<std::string> Split(const std::string& line) {
+        std::vector<std::string> cells;
+        std::stringstream ss(line);
+        std::string cell;
+        while (std::getline(ss, cell, '|')) cells.push_back(cell);
+        return cells;
+    }
+};
+
+// per worker, merged at the end
+struct Stats {
+    std::vector<double> us[kNumKinds];
+    size_t errors[kNumKinds] = {};
+    size_t failures[kNumKinds] = {};
+    // "trw1 commit: not detected" -> calls
+    std::map<std::string, size_t> outcomes;
+};
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        std::fprintf(stderr,
+                     "usage: %s db_dir incremental_dir plugin_dir [threads] [reads_per_write] "
+                     "[max_ops] [limit]\n",
+                     argv[0]);
+        return 1;
+    }
+    std::string db_dir = argv[1], inc_dir = argv[2], plugin_dir = argv[3];
+    size_t threads = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 8;
+    double reads_per_write = argc > 5 ? std::strtod(argv[5], nullptr) : 1.0;
+    int64_t max_ops = argc > 6 ? std::strtoll(argv[6], nullptr, 10) : -1;
+    int64_t limit = argc > 7 ? std::strtoll(argv[7], nullptr, 10) : -1;
+
+    std::vector<Op> writes;
+    auto load = [&](const char* file, OpKind kind, auto&& request) {
+        Csv csv(inc_dir + "/" + file);
+        if (csv.header.empty()) {
+            std::printf("skipped missing %s\n", file);
+            return;
+        }
+        size_t time = csv.Col({"create_time", "createTime", "time"});
+        size_t src = csv.Col({"from_id", "fromId", "srcId", "person_id1", "personId1"});
+        size_t dst = csv.Col({"to_id", "toId", "dstId", "person_id2", "personId2"});
+        for (auto& row : csv.rows) {
+            Op op{std::stoll(row[time]), kind, "", std::stoll(row[src]), std::stoll(row[dst])};
+            json req = {{"srcId", op.src}, {"dstId", op.dst}, {"time", op.time}};
+            request(csv, row, req);
+            op.request = req.dump();
+            writes.push_back(std::move(op));
+        }
+    };
+    auto window = [](const Csv& csv, const std::vector<std::string>& row, json& req) {
+        req["startTime"] = std::stoll(row[csv.Col({"start_time", "startTime"})]);
+        req["endTime"] = std::stoll(row[csv.Col({"end_time", "endTime"})]);
+        // ReadWrite1 has no truncation column and is not truncated
+        size_t col = csv.Find({"truncation_limit", "truncationLimit"});
+        req["limit"] = col == std::string::npos ? -1 : std::stoll(row[col]);
+    };
+    load("AddAccountTransferAccountReadWrite1.csv", kTrw1, [&](auto& csv, auto& row, json& req) {
+        req["amt"] = std::stod(row[csv.Col({"amount"})]);
+        window(csv, row, req);
+    });
+    load("AddAccountTransferAccountReadWrite2.csv", kTrw2, [&](auto& csv, auto& row, json& req) {
+        req["amt"] = std::stod(row[csv.Col({"amount"})]);
+        req["threshold"] = std::stod(row[csv.Col({"amount_threshold", "amountThreshold"})]);
+        window(csv, row, req);
+    });
+    load("AddPersonGuaranteePersonReadWrite3.csv", kTrw3, [&](auto& csv, auto& row, json& req) {
+        req["threshold"] = std::stod(row[csv.Col({"ratio_threshold", "threshold"})]);
+        window(csv, row, req);
+    });
+    load("AddAccountTransferAccountWrite12.csv", kTw12, [&](auto& csv, auto& row, json& req) {
+        req["amt"] = std::stod(row[csv.Col({"amount"})]);
+    });
+    load("AddPersonGuaranteePersonWrite10.csv", kWrite10, [](auto&, auto&, json&) {});
+    std::stable_sort(writes.begin(), writes.end(),
+                     [](const Op& a, const Op& b) { return a.time < b.time; });
+    if (db_dir == "-") {
+        // parse only, for scripts/smoke_replay_mixed.sh
+        size_t parsed[kNumKinds] = {};
+        for (auto& w : writes) parsed[w.kind]++;
+        for (int k = 0; k < kNumKinds; k++) {
+            if (parsed[k]) std::printf("%-8s parsed %zu\n", KIND_NAMES[k], parsed[k]);
+        }
+        for (auto& w : writes) {
+            if (w.kind != kWrite10) std::printf("%s %s\n", KIND_NAMES[w.kind], w.request.c_str());
+        }
+        return 0;
+    }
+
+    lgraph_api::Galaxy galaxy(db_dir, false, true);
+    galaxy.SetCurrentUser("admin", "73@TuGraph");
+    lgraph_api::GraphDB db = galaxy.OpenGraph("default");
+    ProcessFunc plugins[kNumKinds] = {};
+    for (OpKind kind : {kTrw1, kTrw2, kTrw3, kTw12, kTcr8}) {
+        plugins[kind] = LoadPlugin(plugin_dir, KIND_NAMES[kind]);
+    }
+
+    std::vector<int64_t> loans;
+    {
+        auto txn = db.CreateReadTxn();
+        for (auto vit = txn.GetVertexIterator(); vit.IsValid(); vit.Next()) {
+            if (vit.GetLabel() == "Loan") loans.push_back(vit.GetField("id").AsInt64());
+        }
+    }
+    std::vector<Op> ops;
+    double owed_reads = 0;
+    size_t next_loan = 0;
+    for (auto& w : writes) {
+        if (max_ops >= 0 && (int64_t)ops.size() >= max_ops) break;
+        ops.push_back(w);
+        for (owed_reads += reads_per_write; owed_reads >= 1 && !loans.empty(); owed_reads--) {
+            if (max_ops >= 0 && (int64_t)ops.size() >= max_ops) break;
+            // a fixed stride over the loans, so runs are repeatable
+            int64_t loan = loans[next_loan];
+            next_loan = (next_loan + 7919) % loans.size();
+            json req = {{"id", loan},         {"threshold", 0.0}, {"startTime", 0},
+                        {"endTime", w.time}, {"limit", limit}};
+            ops.push_back(Op{w.time, kTcr8, req.dump(), loan, 0});
+        }
+    }
+
+    auto write10 = [&](const Op& op) {
+        static const std::vector<std::string> FIELD_NAMES = {"timestamp"};
+        auto txn = db.CreateWriteTxn();
+        auto p1 = txn.GetVertexByUniqueIndex("Person", "id", lgraph_api::FieldData(op.src));
+        auto p2 = txn.GetVertexByUniqueIndex("Person", "id", lgraph_api::FieldData(op.dst));
+        if (!p1.IsValid() || !p2.IsValid()) {
+            txn.Abort();
+            return false;
+        }
+        txn.AddEdge(p1.GetId(), p2.GetId(), "guarantee", FIELD_NAMES,
+                    std::vector<lgraph_api::FieldData>{lgraph_api::FieldData(op.time)});
+        txn.Commit();
+        return true;
+    };
+    auto run = [&](const Op& op, Stats& stats) {
+        std::string response;
+        try {
+            bool ok = op.kind == kWrite10 ? write10(op)
+                                          : plugins[op.kind](db, op.request, response);
+            if (op.kind != kTcr8 && op.kind != kWrite10) {
+                // a single record {"msg": ..., "txn": ...}
+                json result = json::parse(response);
+                if (result.is_array() && !result.empty()) result = result[0];
+                std::string outcome = std::string(KIND_NAMES[op.kind]) + " " +
+                                      result.value("txn", "?") + ": " + result.value("msg", "?");
+                stats.outcomes[outcome]++;
+            }
+            if (!ok) stats.failures[op.kind]++;
+        } catch (std::exception& e) {
+            std::fprintf(stderr, "%s error: %s\n", KIND_NAMES[op.kind], e.what());
+            stats.errors[op.kind]++;
+        }
+    };
+
+    // as load_procedure.sh does, so the first calls are not measured cold
+    std::string response;
+    for (OpKind kind : {kTrw1, kTrw2, kTrw3, kTw12, kTcr8}) {
+        plugins[kind](db, R"({"warmup": {}})", response);
+    }
+
+    std::vector<Stats> stats(threads);
+    std::atomic<size_t> cursor(0);
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            for (size_t i = cursor++; i < ops.size(); i = cursor++) {
+                auto op_begin = std::chrono::steady_clock::now();
+                run(ops[i], stats[t]);
+                auto op_end = std::chrono::steady_clock::now();
+                stats[t].us[ops[i].kind].push_back(
+                    std::chrono::duration<double, std::micro>(op_end - op_begin).count());
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+    double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    Stats total;
+    for (auto& s : stats) {
+        for (int k = 0; k < kNumKinds; k++) {
+            total.us[k].insert(total.us[k].end(), s.us[k].begin(), s.us[k].end());
+            total.errors[k] += s.errors[k];
+            total.failures[k] += s.failures[k];
+        }
+        for (auto& kv : s.outcomes) total.outcomes[kv.first] += kv.second;
+    }
+    std::printf("ops %zu on %zu threads in %.2f s, %.1f ops/s\n", ops.size(), threads, seconds,
+                ops.size() / seconds);
+    for (int k = 0; k < kNumKinds; k++) {
+        auto& us = total.us[k];
+        if (us.empty()) continue;
+        std::sort(us.begin(), us.end());
+        double sum = 0;
+        for (double x : us) sum += x;
+        std::printf(
+            "%-8s calls %8zu  mean %10.1f us  p50 %10.1f us  p99 %10.1f us  errors %zu  "
+            "failures %zu\n",
+            KIND_NAMES[k], us.size(), sum / us.size(), us[us.size() / 2],
+            us[us.size() * 99 / 100], total.errors[k], total.failures[k]);
+    }
+    for (auto& kv : total.outcomes) std::printf("%8zu  %s\n", kv.second, kv.first.c_str());
+    return 0;
+}
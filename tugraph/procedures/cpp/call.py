@@ -0,0 +1,21 @@
+import sys
+import requests
+import json
+
+if len(sys.argv) < 4:
+    print('usage: %s [endpoint] [plugin_name] [request]' % sys.argv[0])
+    print('[endpoint] should be in the format of [address:port]')
+    print('[request] is the json string passed to the plugin')
+    sys.exit()
+
+endpoint = sys.argv[1] # addr:port
+plugin_name = sys.argv[2]
+request = sys.argv[3]
+
+r = requests.post(url='http://%s/login' % endpoint, data=json.dumps({'user':'admin', 'password':'73@TuGraph'}), headers={'Content-Type':'application/json'})
+jwt = r.json()['jwt']
+
+data = {'data': request, 'timeout': 0, 'in_process': True}
+r = requests.post(url='http://%s/db/default/cpp_plugin/%s' % (endpoint, plugin_name), data=json.dumps(data), headers={'Content-Type':'application/json', 'Authorization':'Bearer %s' % jwt})
+print(r.status_code)
+print(r.content)
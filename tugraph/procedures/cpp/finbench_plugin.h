@@ -0,0 +1,980 @@
+/**
+ * Copyright 2022 AntGroup CO., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ */
+
+/*
+ * Helpers shared by the plugin sources. Unlike finbench_runtime.h, everything here is header-only
+ * and private to the plugin that includes it.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "lgraph/lgraph.h"
+#include "lgraph/lgraph_result.h"
+#include "lgraph/lgraph_types.h"
+#include "lgraph/lgraph_utils.h"
+#include "tools/json.hpp"
+#include "finbench_runtime.h"
+#include "finbench_simd.h"
+
+/*
+ * Caps on the work of one request: edges scanned, vertices expanded and wall-clock time since
+ * construction, each unbounded when negative. Callers charge work as they go and stop expanding
+ * once a charge returns false. The clock is read on every vertex but only every kClockInterval
+ * edges, so a mega-hub is still interrupted within its adjacency.
+ */
+class WorkBudget {
+ public:
+    static constexpr int64_t kClockInterval = 1024;
+
+    WorkBudget(int64_t max_edges, int64_t max_vertices, int64_t timeout_ms)
+        : max_edges_(max_edges),
+          max_vertices_(max_vertices),
+          timeout_ms_(timeout_ms),
+          start_(std::chrono::steady_clock::now()) {}
+
+    // Charges n scanned edges. False once any budget is exhausted.
+    bool Edges(size_t n = 1) {
+        if (exhausted_) return false;
+        edges_ += n;
+        if (max_edges_ >= 0 && edges_ > max_edges_) exhausted_ = true;
+        if (edges_ >= next_clock_) {
+            next_clock_ = edges_ + kClockInterval;
+            _CheckClock();
+        }
+        return !exhausted_;
+    }
+
+    // Charges one expanded vertex. False once any budget is exhausted.
+    bool Vertex() {
+        if (exhausted_) return false;
+        vertices_++;
+        if (max_vertices_ >= 0 && vertices_ > max_vertices_) exhausted_ = true;
+        _CheckClock();
+        return !exhausted_;
+    }
+
+    bool Exhausted() const { return exhausted_; }
+
+    int64_t ScannedEdges() const { return edges_; }
+
+    int64_t VisitedVertices() const { return vertices_; }
+
+    int64_t ElapsedMs() const {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::steady_clock::now() - start_)
+            .count();
+    }
+
+    // e.g. "1024 edges, 17 vertices, 250 ms", for the message of a request that ran out
+    std::string Summary() const {
+        return std::to_string(edges_) + " edges, " + std::to_string(vertices_) + " vertices, " +
+               std::to_string(ElapsedMs()) + " ms";
+    }
+
+ private:
+    void _CheckClock() {
+        if (timeout_ms_ >= 0 && !exhausted_ && ElapsedMs() >= timeout_ms_) exhausted_ = true;
+    }
+
+    int64_t max_edges_, max_vertices_, timeout_ms_;
+    std::chrono::steady_clock::time_point start_;
+    int64_t edges_ = 0;
+    int64_t vertices_ = 0;
+    int64_t next_clock_ = kClockInterval;
+    bool exhausted_ = false;
+};
+
+// How a per-node limit picks the edges it keeps.
+enum class TruncationOrder {
+    // the first N edges of each label, in storage order
+    kStorage,
+    // the N most recent edges of the vertex over all labels, as the driver's truncation expects
+    kTimestampDesc,
+};
+
+template <typename EIT>
+class LabeledEdgeIterator {
+ public:
+    LabeledEdgeIterator(EIT&& eit, const int64_t src, const int64_t dst,
+                        const std::vector<int16_t>& lids, int64_t per_node_limit,
+                        TruncationOrder order = TruncationOrder::kStorage,
+                        WorkBudget* budget = nullptr)
+        : eit_(std::move(eit)) {
+        if (lids.empty()) {
+            valid_ = false;
+            return;
+        }
+        valid_ = true;
+        lid_pos_ = 0;
+        lids_ = lids;
+        src_ = src;
+        dst_ = dst;
+        label_limits_.assign(lids_.size(), per_node_limit);
+        buffered_ = false;
+        if (per_node_limit >= 0 && order == TruncationOrder::kTimestampDesc) {
+            _SelectRecent(per_node_limit, budget);
+        }
+        if (buffered_) {
+            pick_pos_ = 0;
+            valid_ = !picked_.empty() && eit_.Goto(picked_[0]);
+            return;
+        }
+        count_ = 1;
+        eit_.Goto(lgraph_api::EdgeUid(src_, dst_, lids_[lid_pos_], 0, 0), true);
+        while (!_IsCurLabelValid() && _NextLabel()) {
+        }
+    }
+
+    bool IsValid() { return valid_; }
+
+    void Next() {
+        if (buffered_) {
+            valid_ = ++pick_pos_ < picked_.size() && eit_.Goto(picked_[pick_pos_]);
+            return;
+        }
+        count_ += 1;
+        eit_.Next();
+        while (!_IsCurLabelValid() && _NextLabel()) {
+        }
+    }
+
+    lgraph_api::EdgeUid GetUid() { return eit_.GetUid(); }
+
+    EIT& Eit() { return eit_; }
+
+ private:
+    bool _IsCurLabelValid() {
+        return lid_pos_ < lids_.size() && eit_.IsValid() && eit_.GetLabelId() == lids_[lid_pos_] &&
+               (label_limits_[lid_pos_] < 0 || (int64_t)count_ <= label_limits_[lid_pos_]);
+    }
+
+    bool _NextLabel() {
+        count_ = 1;
+        if (++lid_pos_ >= lids_.size()) {
+            valid_ = false;
+            return valid_;
+        }
+        eit_.Goto(lgraph_api::EdgeUid(src_, dst_, lids_[lid_pos_], 0, 0), true);
+        return true;
+    }
+
+    /*
+     * Picks the `limit` most recent edges over all labels. Labels whose temporal id is the
+     * timestamp are stored newest first (tid_order desc in import.conf), so only their first
+     * `limit` edges are read and the pick becomes a per-label prefix length, iterated in storage
+     * order. Any other label is read whole and the picked edges are revisited one by one.
+     *
+     * Every edge read is charged to `budget`; once it runs out the selection stops and the
+     * iterator is left empty.
+     */
+    void _SelectRecent(int64_t limit, WorkBudget* budget) {
+        static const std::string TIMESTAMP = "timestamp";
+        struct Candidate {
+            int64_t ts;
+            size_t lid_pos;
+            lgraph_api::EdgeUid uid;
+        };
+        std::vector<Candidate> candidates;
+        bool all_ordered = true;
+        for (size_t pos = 0; pos < lids_.size(); pos++) {
+            bool ordered = true;
+            int64_t last_ts = std::numeric_limits<int64_t>::max();
+            int64_t n = 0;
+            for (eit_.Goto(lgraph_api::EdgeUid(src_, dst_, lids_[pos], 0, 0), true);
+                 eit_.IsValid() && eit_.GetLabelId() == lids_[pos]; eit_.Next()) {
+                int64_t ts = eit_.GetField(TIMESTAMP).AsInt64();
+                ordered = ordered && eit_.GetTemporalId() == ts && ts <= last_ts;
+                last_ts = ts;
+                if (ordered && n >= limit) break;
+                if (budget && !budget->Edges()) {
+                    buffered_ = true;
+                    return;
+                }
+                candidates.push_back({ts, pos, eit_.GetUid()});
+                n++;
+            }
+            all_ordered = all_ordered && ordered;
+        }
+        auto newer = [](const Candidate& l, const Candidate& r) { return l.ts > r.ts; };
+        if ((int64_t)candidates.size() > limit) {
+            std::nth_element(candidates.begin(), candidates.begin() + limit, candidates.end(),
+                             newer);
+            candidates.resize(limit);
+        }
+        if (all_ordered) {
+            std::fill(label_limits_.begin(), label_limits_.end(), 0);
+            for (auto& c : candidates) label_limits_[c.lid_pos]++;
+        } else {
+            buffered_ = true;
+            std::sort(candidates.begin(), candidates.end(), newer);
+            picked_.reserve(candidates.size());
+            for (auto& c : candidates) picked_.push_back(c.uid);
+        }
+    }
+
+    EIT eit_;
+    bool valid_;
+    int64_t src_, dst_;
+    size_t count_;
+    size_t lid_pos_;
+    std::vector<int16_t> lids_;
+    std::vector<int64_t> label_limits_;
+    bool buffered_;
+    size_t pick_pos_;
+    std::vector<lgraph_api::EdgeUid> picked_;
+};
+
+typedef LabeledEdgeIterator<lgraph_api::OutEdgeIterator> LabeledOutEdgeIterator;
+typedef LabeledEdgeIterator<lgraph_api::InEdgeIterator> LabeledInEdgeIterator;
+
+/*
+ * A BFS frontier kept as an ascending, deduplicated vid vector. Expanding it in vid order walks
+ * the vertex and edge storage front to back instead of jumping around in hash order.
+ */
+class Frontier {
+ public:
+    void Add(int64_t vid) { vids_.push_back(vid); }
+
+    // Sorts and deduplicates what was added since the last call.
+    void Seal() {
+        std::sort(vids_.begin(), vids_.end());
+        vids_.erase(std::unique(vids_.begin(), vids_.end()), vids_.end());
+    }
+
+    bool Empty() const { return vids_.empty(); }
+
+    size_t Size() const { return vids_.size(); }
+
+    size_t Capacity() const { return vids_.capacity(); }
+
+    int64_t operator[](size_t i) const { return vids_[i]; }
+
+    const std::vector<int64_t>& Vids() const { return vids_; }
+
+    void Clear() { vids_.clear(); }
+
+    void Swap(Frontier& other) { vids_.swap(other.vids_); }
+
+ private:
+    std::vector<int64_t> vids_;
+};
+
+/*
+ * Touches the adjacency of the next `distance` frontier vertices from a helper thread with its
+ * own read transaction, so that page faults on a graph larger than the page cache overlap with
+ * the processing of the current vertex. Small frontiers are not worth a thread and are skipped.
+ * A helper that gets `distance` ahead sleeps until the caller advances. Only for read-only
+ * plugins: next to a write transaction the helper's read transaction would not see its edges.
+ *
+ * Each helper holds a second reader slot, so at most kMaxHelpers run per plugin and the others
+ * are skipped. Prefetching is only ever an optimization: a helper that fails, e.g. because no
+ * reader slot is left, stops quietly, and no helper is started for kBackoffMs after that.
+ */
+class AdjacencyPrefetcher {
+ public:
+    static constexpr size_t kMinFrontier = 64;
+    static constexpr int kMaxHelpers = 4;
+    static constexpr int64_t kBackoffMs = 1000;
+
+    AdjacencyPrefetcher(lgraph_api::GraphDB& db, const std::vector<int64_t>& vids,
+                        const std::vector<int16_t>& lids, size_t distance)
+        : cursor_(0), waiting_(false), stop_(false) {
+        if (distance == 0 || vids.size() < kMinFrontier || _Now() < _BackoffUntil().load()) {
+            return;
+        }
+        if (_Helpers().fetch_add(1) >= kMaxHelpers) {
+            _Helpers().fetch_sub(1);
+            return;
+        }
+        try {
+            thread_ = std::thread([this, &db, &vids, &lids, distance]() {
+                try {
+                    _Run(db, vids, lids, distance);
+                } catch (...) {
+                    _BackoffUntil().store(_Now() + kBackoffMs);
+                }
+                _Helpers().fetch_sub(1);
+            });
+        } catch (...) {
+            _Helpers().fetch_sub(1);
+        }
+    }
+
+    ~AdjacencyPrefetcher() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_.store(true);
+        }
+        wake_.notify_one();
+        if (thread_.joinable()) thread_.join();
+    }
+
+    // Reports that the caller has reached position `pos` of the frontier.
+    void Advance(size_t pos) {
+        // cursor_ is stored before waiting_ is read and the helper does the reverse, both
+        // sequentially consistent, so one of them sees the other and no wake-up is lost
+        cursor_.store(pos);
+        if (waiting_.load()) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            wake_.notify_one();
+        }
+    }
+
+ private:
+    void _Run(lgraph_api::GraphDB& db, const std::vector<int64_t>& vids,
+              const std::vector<int16_t>& lids, size_t distance) {
+        auto txn = db.CreateReadTxn();
+        auto vit = txn.GetVertexIterator();
+        for (size_t i = 0; i < vids.size() && !stop_.load(); i++) {
+            if (i > cursor_.load() + distance) {
+                std::unique_lock<std::mutex> lock(mutex_);
+                waiting_.store(true);
+                wake_.wait(lock,
+                           [&]() { return stop_.load() || i <= cursor_.load() + distance; });
+                waiting_.store(false);
+                if (stop_.load()) return;
+            }
+            if (!vit.Goto(vids[i])) continue;
+            for (auto lid : lids) {
+                vit.GetOutEdgeIterator(lgraph_api::EdgeUid(vids[i], 0, lid, 0, 0), true);
+            }
+        }
+    }
+
+    static int64_t _Now() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    // helpers running in this plugin
+    static std::atomic<int>& _Helpers() {
+        static std::atomic<int> helpers(0);
+        return helpers;
+    }
+
+    static std::atomic<int64_t>& _BackoffUntil() {
+        static std::atomic<int64_t> until(0);
+        return until;
+    }
+
+    std::atomic<size_t> cursor_;
+    std::atomic<bool> waiting_;
+    std::atomic<bool> stop_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::thread thread_;
+};
+
+/*
+ * The edges of one vertex, for some labels and one direction, as EdgeColumns. Vertices above the
+ * degree threshold come from the EdgeColumns cache in libfinbench_runtime. The window predicate
+ * then runs on contiguous arrays with the kernels of finbench_simd.h instead of decoding a
+ * FieldData per edge. Every label is newest first and the `limit` most recent edges are kept as
+ * per-label prefixes. The edges therefore come out in the same order as from a
+ * LabeledEdgeIterator with TruncationOrder::kTimestampDesc.
+ */
+class AdjacencyColumns {
+ public:
+    // `stamp` is EdgeColumnsStamp(), read before the caller's transaction was opened.
+    explicit AdjacencyColumns(int64_t stamp) : stamp_(stamp) {}
+
+    /*
+     * Loads the edges of the vertex `vit` is on. A label missing from the cache is scanned: with
+     * `limit` >= 0 only as far as the truncation needs and without filling the cache, else whole,
+     * filling the cache if it has at least EdgeColumnsMinDegree() edges. With `cached_only` only
+     * cache hits are used, and false is returned on a miss, which the caller then iterates. This
+     * is for the sides of a write transaction that hold its own uncommitted edge, which the caller
+     * accounts for itself.
+     *
+     * With a `budget`, a scan is charged every edge it reads and stops once the budget runs out,
+     * filling nothing; a cache hit is charged the edges the limit keeps. The caller checks
+     * budget->Exhausted() before using the result.
+     */
+    bool Load(lgraph_api::VertexIterator& vit, const std::vector<int16_t>& lids, bool out,
+              int64_t limit, bool cached_only = false, WorkBudget* budget = nullptr) {
+        vid_ = vit.GetId();
+        out_ = out;
+        lids_ = lids;
+        columns_.assign(lids.size(), nullptr);
+        std::vector<bool> hit(lids.size(), false);
+        for (size_t pos = 0; pos < lids.size(); pos++) {
+            std::shared_ptr<const EdgeColumns> columns;
+            if (EdgeColumnsLookup(vid_, lids[pos], out, stamp_, columns) && columns) {
+                columns_[pos] = std::move(columns);
+                hit[pos] = true;
+                continue;
+            }
+            if (cached_only) return false;
+            columns = _Scan(vit, lids[pos], limit, budget);
+            if (limit < 0 && columns->Size() >= EdgeColumnsMinDegree() &&
+                !(budget && budget->Exhausted())) {
+                EdgeColumnsInsert(vid_, lids[pos], out, stamp_, columns);
+            }
+            columns_[pos] = std::move(columns);
+        }
+        _Truncate(limit);
+        if (budget) {
+            size_t kept = 0;
+            for (size_t pos = 0; pos < lids.size(); pos++) kept += hit[pos] ? kept_[pos] : 0;
+            if (kept) budget->Edges(kept);
+        }
+        return true;
+    }
+
+    size_t Labels() const { return columns_.size(); }
+
+    const EdgeColumns& Label(size_t pos) const { return *columns_[pos]; }
+
+    // Number of leading edges of the label that the limit keeps.
+    size_t Kept(size_t pos) const { return kept_[pos]; }
+
+    // f(pos, i) for every kept edge with start < ts < end and amount > min_amount.
+    template <typename F>
+    void ForEachInWindow(int64_t start, int64_t end, double min_amount, F&& f) {
+        for (size_t pos = 0; pos < columns_.size(); pos++) {
+            auto& c = *columns_[pos];
+            picked_.resize(kept_[pos]);
+            size_t n = FilterWindow(c.ts.data(), c.amount.data(), kept_[pos], start, end,
+                                    min_amount, picked_.data());
+            for (size_t j = 0; j < n; j++) f(pos, picked_[j]);
+        }
+    }
+
+    size_t CountInWindow(int64_t start, int64_t end, double min_amount) const {
+        size_t count = 0;
+        for (size_t pos = 0; pos < columns_.size(); pos++) {
+            auto& c = *columns_[pos];
+            count += CountWindow(c.ts.data(), c.amount.data(), kept_[pos], start, end, min_amount);
+        }
+        return count;
+    }
+
+    lgraph_api::EdgeUid Uid(size_t pos, size_t i) const {
+        auto& c = *columns_[pos];
+        return out_ ? lgraph_api::EdgeUid(vid_, c.other[i], lids_[pos], c.tid[i], c.eid[i])
+                    : lgraph_api::EdgeUid(c.other[i], vid_, lids_[pos], c.tid[i], c.eid[i]);
+    }
+
+ private:
+    /*
+     * The edges of one label, newest first. With `limit` >= 0 the scan stops after `limit` edges
+     * as long as the label is stored newest first (see LabeledEdgeIterator::_SelectRecent), since
+     * the truncation keeps a prefix then. Stops early, too, once `budget` runs out.
+     */
+    std::shared_ptr<const EdgeColumns> _Scan(lgraph_api::VertexIterator& vit, int16_t lid,
+                                             int64_t limit, WorkBudget* budget) {
+        static const std::string TIMESTAMP = "timestamp";
+        static const std::string AMOUNT = "amount";
+        auto columns = std::make_shared<EdgeColumns>();
+        bool ordered = true;
+        // false once the truncation has all it needs
+        auto add = [&](auto& eit, int64_t other) {
+            int64_t ts = eit.GetField(TIMESTAMP).AsInt64();
+            ordered = ordered && eit.GetTemporalId() == ts &&
+                      (columns->ts.empty() || ts <= columns->ts.back());
+            if (ordered && limit >= 0 && (int64_t)columns->Size() >= limit) return false;
+            if (budget && !budget->Edges()) return false;
+            columns->other.push_back(other);
+            columns->ts.push_back(ts);
+            columns->amount.push_back(eit.GetField(AMOUNT).AsDouble());
+            columns->tid.push_back(eit.GetTemporalId());
+            columns->eid.push_back(eit.GetEdgeId());
+            return true;
+        };
+        if (out_) {
+            for (auto eit = vit.GetOutEdgeIterator(lgraph_api::EdgeUid(vid_, 0, lid, 0, 0), true);
+                 eit.IsValid() && eit.GetLabelId() == lid && add(eit, eit.GetDst()); eit.Next()) {
+            }
+        } else {
+            for (auto eit = vit.GetInEdgeIterator(lgraph_api::EdgeUid(0, vid_, lid, 0, 0), true);
+                 eit.IsValid() && eit.GetLabelId() == lid && add(eit, eit.GetSrc()); eit.Next()) {
+            }
+        }
+        auto& ts = columns->ts;
+        if (!std::is_sorted(ts.begin(), ts.end(), std::greater<int64_t>())) {
+            // a label not stored newest first; reorder once so that truncation keeps a prefix
+            std::vector<size_t> order(ts.size());
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(),
+                             [&](size_t l, size_t r) { return ts[l] > ts[r]; });
+            auto sorted = std::make_shared<EdgeColumns>();
+            for (auto i : order) {
+                sorted->other.push_back(columns->other[i]);
+                sorted->ts.push_back(columns->ts[i]);
+                sorted->amount.push_back(columns->amount[i]);
+                sorted->tid.push_back(columns->tid[i]);
+                sorted->eid.push_back(columns->eid[i]);
+            }
+            return sorted;
+        }
+        return columns;
+    }
+
+    // same pick as LabeledEdgeIterator::_SelectRecent on labels stored newest first
+    void _Truncate(int64_t limit) {
+        kept_.resize(columns_.size());
+        for (size_t pos = 0; pos < columns_.size(); pos++) {
+            size_t n = columns_[pos]->Size();
+            kept_[pos] = limit < 0 ? n : std::min(n, static_cast<size_t>(limit));
+        }
+        if (limit < 0 || columns_.size() == 1) return;
+        std::vector<std::pair<int64_t, size_t>> candidates;
+        for (size_t pos = 0; pos < columns_.size(); pos++) {
+            for (size_t i = 0; i < kept_[pos]; i++) {
+                candidates.emplace_back(columns_[pos]->ts[i], pos);
+            }
+        }
+        if ((int64_t)candidates.size() <= limit) return;
+        std::nth_element(candidates.begin(), candidates.begin() + limit, candidates.end(),
+                         [](const std::pair<int64_t, size_t>& l,
+                            const std::pair<int64_t, size_t>& r) { return l.first > r.first; });
+        std::fill(kept_.begin(), kept_.end(), 0);
+        for (int64_t i = 0; i < limit; i++) kept_[candidates[i].second]++;
+    }
+
+    int64_t stamp_;
+    int64_t vid_;
+    bool out_;
+    std::vector<int16_t> lids_;
+    std::vector<std::shared_ptr<const EdgeColumns>> columns_;
+    std::vector<size_t> kept_;
+    std::vector<uint32_t> picked_;
+};
+
+/*
+ * Edges of the vertex `vit` is on with the given labels in one direction, up to kDegreeStatsCap
+ * per label. Only meant for planning: taken from the degree sidecar or the cached edge columns,
+ * else counted and recorded. With `limit` >= 0 the caller only tells degrees apart up to limit,
+ * so counting stops at limit + 1 edges, and a count cut short there is not recorded.
+ */
+inline size_t EstimateDegree(lgraph_api::VertexIterator& vit, const std::vector<int16_t>& lids,
+                             bool out, int64_t stamp, int64_t limit = -1) {
+    int64_t vid = vit.GetId();
+    uint32_t cap = limit < 0 ? kDegreeStatsCap
+                             : (uint32_t)std::min<int64_t>(limit + 1, kDegreeStatsCap);
+    auto count = [cap](auto&& eit, int16_t lid) {
+        uint32_t n = 0;
+        for (; eit.IsValid() && eit.GetLabelId() == lid && n < cap; eit.Next()) n++;
+        return n;
+    };
+    size_t total = 0;
+    // same pick as LabeledEdgeIterator::_SelectRecent on labels stored newest first
+    for (auto lid : lids) {
+        if (limit >= 0 && total > (size_t)limit) break;
+        uint32_t degree;
+        if (!DegreeStatsLookup(vid, lid, out, degree)) {
+            std::shared_ptr<const EdgeColumns> columns;
+            if (EdgeColumnsLookup(vid, lid, out, stamp, columns) && columns) {
+                degree = std::min<size_t>(columns->Size(), kDegreeStatsCap);
+                DegreeStatsInsert(vid, lid, out, degree);
+            } else {
+                if (out) {
+                    degree = count(
+                        vit.GetOutEdgeIterator(lgraph_api::EdgeUid(vid, 0, lid, 0, 0), true), lid);
+                } else {
+                    degree = count(
+                        vit.GetInEdgeIterator(lgraph_api::EdgeUid(0, vid, lid, 0, 0), true), lid);
+                }
+                if (degree < cap || cap == kDegreeStatsCap) {
+                    DegreeStatsInsert(vid, lid, out, degree);
+                }
+            }
+        }
+        total += degree;
+    }
+    return total;
+}
+
+/*
+ * Body of the warm-up request {"warmup": {"top": N}}, which every plugin answers instead of its
+ * query and load_procedure.sh sends to each one after installing it, so that the first real call
+ * finds the plugin's statics built, the schema ids bound and the isBlocked bitmap loaded. With
+ * N > 0 it also reads the transfer, withdraw, deposit and repay edges of the N accounts and loans
+ * with the most of them among kWarmUpSample * N vertices picked at random, pulling their pages in
+ * before traffic does. The sample is counted locally, without filling the degree sidecar.
+ */
+constexpr int64_t kWarmUpSample = 16;
+
+inline bool WarmUp(lgraph_api::GraphDB& db, int64_t top, std::string& response) {
+    static const std::string TIMESTAMP = "timestamp";
+    static const std::string AMOUNT = "amount";
+    auto begin = std::chrono::steady_clock::now();
+    BlockedLoad(db);
+    auto txn = db.CreateReadTxn();
+    const SchemaIds& schema = Schema(txn);
+    uint16_t account = schema.vertex_label[static_cast<size_t>(IdSpace::kAccount)];
+    uint16_t loan = schema.vertex_label[static_cast<size_t>(IdSpace::kLoan)];
+    std::vector<int16_t> account_out = {schema.transfer, schema.withdraw, schema.repay};
+    std::vector<int16_t> account_in = {schema.transfer, schema.withdraw, schema.deposit};
+    std::vector<int16_t> loan_out = {schema.deposit};
+    std::vector<int16_t> loan_in = {schema.repay};
+    // up to kDegreeStatsCap edges per label, as a ranking key only
+    auto degree = [](lgraph_api::VertexIterator& vit, const std::vector<int16_t>& lids, bool out) {
+        int64_t vid = vit.GetId();
+        size_t total = 0;
+        auto count = [&](auto&& eit, int16_t lid) {
+            for (uint32_t n = 0; eit.IsValid() && eit.GetLabelId() == lid && n < kDegreeStatsCap;
+                 eit.Next(), n++) {
+                total++;
+            }
+        };
+        for (auto lid : lids) {
+            if (out) {
+                count(vit.GetOutEdgeIterator(lgraph_api::EdgeUid(vid, 0, lid, 0, 0), true), lid);
+            } else {
+                count(vit.GetInEdgeIterator(lgraph_api::EdgeUid(0, vid, lid, 0, 0), true), lid);
+            }
+        }
+        return total;
+    };
+    // (degree, vid), the smallest kept degree on top
+    std::vector<std::pair<size_t, int64_t>> hot;
+    auto by_degree = std::greater<std::pair<size_t, int64_t>>();
+    if (top > 0) {
+        // the nearest vertex at or past `bound` exists until bound passes the largest vid
+        int64_t bound = 1;
+        while (txn.GetVertexIterator(bound, true).IsValid()) bound *= 2;
+        std::mt19937_64 rng(bound);
+        std::uniform_int_distribution<int64_t> pick(0, bound - 1);
+        std::unordered_set<int64_t> seen;
+        for (int64_t i = 0; i < top * kWarmUpSample; i++) {
+            auto vit = txn.GetVertexIterator(pick(rng), true);
+            if (!vit.IsValid() || !seen.insert(vit.GetId()).second) continue;
+            uint16_t label = vit.GetLabelId();
+            if (label != account && label != loan) continue;
+            bool is_account = label == account;
+            size_t d = degree(vit, is_account ? account_out : loan_out, true) +
+                       degree(vit, is_account ? account_in : loan_in, false);
+            if (hot.size() < static_cast<size_t>(top)) {
+                hot.emplace_back(d, vit.GetId());
+                std::push_heap(hot.begin(), hot.end(), by_degree);
+            } else if (d > hot.front().first) {
+                std::pop_heap(hot.begin(), hot.end(), by_degree);
+                hot.back() = {d, vit.GetId()};
+                std::push_heap(hot.begin(), hot.end(), by_degree);
+            }
+        }
+    }
+    size_t edges = 0;
+    auto touch = [&](auto&& eit, const std::vector<int16_t>& lids) {
+        for (; eit.IsValid(); eit.Next()) {
+            if (std::find(lids.begin(), lids.end(), eit.GetLabelId()) == lids.end()) continue;
+            // the fields every plugin reads, so their pages are pulled in with the adjacency
+            eit.GetField(TIMESTAMP);
+            eit.GetField(AMOUNT);
+            edges++;
+        }
+    };
+    auto vit = txn.GetVertexIterator();
+    for (auto& item : hot) {
+        if (!vit.Goto(item.second)) continue;
+        bool is_account = vit.GetLabelId() == account;
+        touch(vit.GetOutEdgeIterator(), is_account ? account_out : loan_out);
+        touch(vit.GetInEdgeIterator(), is_account ? account_in : loan_in);
+    }
+    double elapsed_ms = std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - begin).count();
+    response = "{\"vertices\":" + std::to_string(hot.size()) +
+               ",\"edges\":" + std::to_string(edges) +
+               ",\"elapsedMs\":" + std::to_string(elapsed_ms) + "}";
+    return true;
+}
+
+/*
+ * Body of the plugins that add one edge with a timestamp and an amount to an account: tw12
+ * (transfer), tw13 (withdraw) and tw15 (deposit). Parses {src_key, dst_key, "time", "amt"},
+ * answers warm-up requests, and commits the edge under an EdgeColumnsWriteGuard on both ends, then
+ * bumps their degree statistics and logs the insert for materialized tcr8 results.
+ */
+inline bool AddAmountEdge(lgraph_api::GraphDB& db, const std::string& request,
+                          std::string& response, IdSpace src_space, const std::string& src_label,
+                          const char* src_key, const char* dst_key,
+                          const std::string& edge_label) {
+    static const std::string ACCOUNT_LABEL = "Account";
+    static const std::string ID = "id";
+    static const std::vector<std::string> EDGE_FIELD_NAMES = {"timestamp", "amount"};
+    lgraph_api::Result api_result(
+        {{"msg", lgraph_api::LGraphType::STRING}, {"txn", lgraph_api::LGraphType::STRING}});
+    auto& record = api_result.NewRecord();
+    record.Insert("txn", lgraph_api::FieldData::String("abort"));
+    int64_t src_id, dst_id, time;
+    double amt;
+    try {
+        nlohmann::json input = nlohmann::json::parse(request);
+        if (input.contains("warmup")) {
+            return WarmUp(db, input["warmup"].value("top", (int64_t)0), response);
+        }
+        lgraph_api::parse_from_json(src_id, src_key, input);
+        lgraph_api::parse_from_json(dst_id, dst_key, input);
+        lgraph_api::parse_from_json(time, "time", input);
+        lgraph_api::parse_from_json(amt, "amt", input);
+    } catch (std::exception& e) {
+        record.Insert("msg", lgraph_api::FieldData::String("json parse error: " +
+                                                           std::string(e.what())));
+        response = api_result.Dump();
+        return false;
+    }
+    auto txn = db.CreateWriteTxn();
+    auto src = GetVertexById(txn, src_space, src_label, ID, src_id);
+    auto dst = GetVertexById(txn, IdSpace::kAccount, ACCOUNT_LABEL, ID, dst_id);
+    if (!src.IsValid() || !dst.IsValid()) {
+        record.Insert("msg", lgraph_api::FieldData::String("src/dst invalid"));
+        response = api_result.Dump();
+        txn.Abort();
+        return true;
+    }
+    std::vector<lgraph_api::FieldData> fields = {lgraph_api::FieldData(time),
+                                                 lgraph_api::FieldData(amt)};
+    auto uid = txn.AddEdge(src.GetId(), dst.GetId(), edge_label, EDGE_FIELD_NAMES, fields);
+    record.Insert("msg", lgraph_api::FieldData::String("added"));
+    record.Insert("txn", lgraph_api::FieldData::String("commit"));
+    response = api_result.Dump();
+    {
+        EdgeColumnsWriteGuard guard({src.GetId(), dst.GetId()});
+        txn.Commit();
+    }
+    DegreeStatsAddEdge(uid.src, uid.dst, uid.lid);
+    if (EdgeLogEnabled()) EdgeLogAppend(uid, time, amt);
+    return true;
+}
+
+/*
+ * Expansion callback for FindCycle: the edges of some labels with start < ts < end that the
+ * per-node limit keeps, newest first. Cached vertices are read from the edge columns unless
+ * `use_columns` is false, e.g. in a write transaction whose own new edge the cache lacks.
+ */
+class WindowedExpander {
+ public:
+    WindowedExpander(lgraph_api::Transaction& txn, const std::vector<int16_t>& lids,
+                     int64_t start_time, int64_t end_time, int64_t limit, int64_t stamp,
+                     bool use_columns = true)
+        : vit_(txn.GetVertexIterator()),
+          lids_(lids),
+          start_time_(start_time),
+          end_time_(end_time),
+          limit_(limit),
+          use_columns_(use_columns),
+          columns_stamp_(stamp),
+          columns_(stamp) {}
+
+    // Estimated number of edges operator() scans for vid, before the window is applied.
+    size_t Degree(int64_t vid, bool out) {
+        if (!vit_.Goto(vid)) return 0;
+        size_t degree = EstimateDegree(vit_, lids_, out, columns_stamp_, limit_);
+        return limit_ < 0 ? degree : std::min<size_t>(degree, limit_);
+    }
+
+    // f(other, ts) for the kept out- or in-edges of vid in the window
+    template <typename F>
+    void operator()(int64_t vid, bool out, F&& f) {
+        static const std::string TIMESTAMP = "timestamp";
+        if (!vit_.Goto(vid)) return;
+        if (use_columns_ && columns_.Load(vit_, lids_, out, limit_)) {
+            columns_.ForEachInWindow(start_time_, end_time_,
+                                     -std::numeric_limits<double>::infinity(),
+                                     [&](size_t pos, size_t i) {
+                                         auto& c = columns_.Label(pos);
+                                         f(c.other[i], c.ts[i]);
+                                     });
+            return;
+        }
+        auto visit = [&](auto&& eit, bool out) {
+            for (; eit.IsValid(); eit.Next()) {
+                auto ts = eit.Eit().GetField(TIMESTAMP).AsInt64();
+                if (ts > start_time_ && ts < end_time_) {
+                    f(out ? eit.Eit().GetDst() : eit.Eit().GetSrc(), ts);
+                }
+            }
+        };
+        if (out) {
+            visit(LabeledEdgeIterator<lgraph_api::OutEdgeIterator>(
+                      vit_.GetOutEdgeIterator(), vid, 0, lids_, limit_,
+                      TruncationOrder::kTimestampDesc),
+                  true);
+        } else {
+            visit(LabeledEdgeIterator<lgraph_api::InEdgeIterator>(
+                      vit_.GetInEdgeIterator(), 0, vid, lids_, limit_,
+                      TruncationOrder::kTimestampDesc),
+                  false);
+        }
+    }
+
+ private:
+    lgraph_api::VertexIterator vit_;
+    std::vector<int16_t> lids_;
+    int64_t start_time_, end_time_;
+    int64_t limit_;
+    bool use_columns_;
+    int64_t columns_stamp_;
+    AdjacencyColumns columns_;
+};
+
+/*
+ * Arrivals at one vertex of a FindCycle layer through up to kMax distinct predecessors, best time
+ * first. The root of a search is recorded as predecessor -1, which is not an intermediate vertex.
+ */
+struct CycleVias {
+    static constexpr size_t kMax = 3;
+    // (predecessor, time)
+    std::pair<int64_t, int64_t> via[kMax];
+    size_t n = 0;
+
+    template <typename Better>
+    void Add(int64_t pred, int64_t ts, Better&& better) {
+        size_t pos = 0;
+        while (pos < n && via[pos].first != pred) pos++;
+        if (pos < n) {
+            if (!better(ts, via[pos].second)) return;
+        } else if (n < kMax) {
+            pos = n++;
+        } else if (better(ts, via[kMax - 1].second)) {
+            pos = kMax - 1;
+        } else {
+            return;
+        }
+        via[pos] = {pred, ts};
+        for (; pos > 0 && better(via[pos].second, via[pos - 1].second); pos--) {
+            std::swap(via[pos], via[pos - 1]);
+        }
+    }
+};
+
+/*
+ * Whether an edge src -> dst would close a simple cycle of K edges, i.e. whether there is a path
+ * of K - 1 edges from dst back to src whose inner vertices are distinct and differ from src and
+ * dst. The path is searched from both ends: K / 2 hops forward from dst and (K - 1) / 2 hops
+ * backward from src, meeting on the vertices of the two last layers.
+ *
+ * `expand(vid, out, f)` calls f(other, ts) for every edge of vid in the requested direction that
+ * the caller accepts (labels, window, truncation). With `ascending`, timestamps must strictly
+ * increase along the path. Each layer keeps, per vertex, the earliest arrivals (forward) or latest
+ * departures (backward) through up to three distinct predecessors. With at most two stored hops
+ * per side, a meeting edge a -> b can only rule out two of the predecessors of either end for
+ * being on the other side's path, so one of the three kept is as good as any other.
+ *
+ * With `reversed` the same paths are searched on the reversed graph, from src towards dst, so the
+ * two ends swap roles; see PlanCycleReversed.
+ */
+template <size_t K, typename Expand>
+bool FindCycleFrom(int64_t src, int64_t dst, bool ascending, Expand&& expand) {
+    static_assert(K >= 3 && K <= 6, "cycle length must be within 3..6");
+    constexpr size_t kForward = K / 2;
+    constexpr size_t kBackward = (K - 1) / 2;
+    constexpr int64_t kMin = std::numeric_limits<int64_t>::min();
+    constexpr int64_t kMax = std::numeric_limits<int64_t>::max();
+    auto later = [](int64_t l, int64_t r) { return l > r; };
+    auto earlier = [](int64_t l, int64_t r) { return l < r; };
+    // the ends are never inner vertices, nor is a vertex its own successor
+    auto inner = [&](int64_t vid, int64_t from) {
+        return vid != src && vid != dst && vid != from;
+    };
+    // vid -> latest departures towards src; only the first layer is expanded further, and its
+    // predecessor is the root, so its best time is the one to expand with
+    std::unordered_map<int64_t, CycleVias> backward, next;
+    backward[src].Add(-1, kMax, later);
+    for (size_t hop = 0; hop < kBackward; hop++) {
+        next.clear();
+        for (auto& v : backward) {
+            int64_t departure = v.second.via[0].second;
+            expand(v.first, false, [&](int64_t other, int64_t ts) {
+                if ((ascending && ts >= departure) || !inner(other, v.first)) return;
+                next[other].Add(hop == 0 ? -1 : v.first, ascending ? ts : kMax, later);
+            });
+        }
+        backward.swap(next);
+        if (backward.empty()) return false;
+    }
+    // whether a -> b at ts joins a forward arrival at a with a backward departure from b on
+    // distinct inner vertices
+    auto joins = [&](int64_t a, const CycleVias& forward, int64_t b, const CycleVias& departures,
+                     int64_t ts) {
+        for (size_t i = 0; i < forward.n; i++) {
+            int64_t fa = forward.via[i].first;
+            if (ascending && forward.via[i].second >= ts) break;
+            if (fa == b) continue;
+            for (size_t j = 0; j < departures.n; j++) {
+                int64_t bb = departures.via[j].first;
+                if (ascending && departures.via[j].second <= ts) break;
+                if (bb != a && (bb < 0 || bb != fa)) return true;
+            }
+        }
+        return false;
+    };
+    // vid -> earliest arrivals from dst; the last hop probes `backward` instead of being stored
+    std::unordered_map<int64_t, CycleVias> forward;
+    forward[dst].Add(-1, kMin, earlier);
+    for (size_t hop = 0; hop < kForward; hop++) {
+        bool last = hop + 1 == kForward;
+        bool found = false;
+        next.clear();
+        for (auto& v : forward) {
+            int64_t arrival = v.second.via[0].second;
+            expand(v.first, true, [&](int64_t other, int64_t ts) {
+                if (found || (ascending && ts <= arrival) || !inner(other, v.first)) return;
+                if (last) {
+                    auto it = backward.find(other);
+                    found = it != backward.end() &&
+                            joins(v.first, v.second, other, it->second, ts);
+                    return;
+                }
+                next[other].Add(hop == 0 ? -1 : v.first, ascending ? ts : kMin, earlier);
+            });
+            if (found) return true;
+        }
+        if (last) return false;
+        forward.swap(next);
+        if (forward.empty()) return false;
+    }
+    return false;
+}
+
+template <size_t K, typename Expand>
+bool FindCycle(int64_t src, int64_t dst, bool ascending, Expand&& expand, bool reversed = false) {
+    if (!reversed) return FindCycleFrom<K>(src, dst, ascending, expand);
+    // negated timestamps still increase along a walk read backwards
+    auto backwards = [&](int64_t vid, bool out, auto&& f) {
+        expand(vid, !out, [&](int64_t other, int64_t ts) { f(other, -ts); });
+    };
+    return FindCycleFrom<K>(dst, src, ascending, backwards);
+}
+
+/*
+ * Whether FindCycle<K> should run reversed, given the edge counts of the first hops at both ends:
+ * the in-edges of src and the out-edges of dst. Hashing an edge into a layer costs more than
+ * probing one. For odd K both sides are equally deep and the one hashed throughout, backward from
+ * src, should start at the smaller end; for even K the forward side is one hop deeper, so it
+ * should start there instead. Skewed pairs are where this pays off.
+ */
+template <size_t K>
+bool PlanCycleReversed(size_t src_in, size_t dst_out) {
+    return K % 2 ? src_in > dst_out : src_in < dst_out;
+}
@@ -0,0 +1,566 @@
+/**
+ * Copyright 2022 AntGroup CO., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ */
+
+#include "finbench_runtime.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+class IdCache {
+ public:
+    static constexpr size_t kShards = 64;
+    static constexpr size_t kMaxEntriesPerShard = 1 << 16;
+
+    bool Lookup(IdSpace space, int64_t id, int64_t& vid) {
+        auto& shard = GetShard(space, id);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.map.find(Key(space, id));
+        if (it == shard.map.end()) return false;
+        vid = it->second;
+        return true;
+    }
+
+    void Insert(IdSpace space, int64_t id, int64_t vid) {
+        auto& shard = GetShard(space, id);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        // crude bound on memory: a full shard starts over instead of tracking recency
+        if (shard.map.size() >= kMaxEntriesPerShard) shard.map.clear();
+        shard.map[Key(space, id)] = vid;
+    }
+
+    void Erase(IdSpace space, int64_t id) {
+        auto& shard = GetShard(space, id);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        shard.map.erase(Key(space, id));
+    }
+
+    void Clear() {
+        for (auto& shard : shards_) {
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            shard.map.clear();
+        }
+    }
+
+ private:
+    struct KeyHash {
+        size_t operator()(const std::pair<uint8_t, int64_t>& k) const {
+            return std::hash<int64_t>()(k.second) * 31 + k.first;
+        }
+    };
+
+    struct alignas(64) Shard {
+        std::shared_mutex mutex;
+        std::unordered_map<std::pair<uint8_t, int64_t>, int64_t, KeyHash> map;
+    };
+
+    static std::pair<uint8_t, int64_t> Key(IdSpace space, int64_t id) {
+        return {static_cast<uint8_t>(space), id};
+    }
+
+    Shard& GetShard(IdSpace space, int64_t id) {
+        uint64_t h = static_cast<uint64_t>(id) * 0x9E3779B97F4A7C15ull + static_cast<uint8_t>(space);
+        return shards_[(h >> 32) % kShards];
+    }
+
+    std::array<Shard, kShards> shards_;
+};
+
+IdCache& GetIdCache() {
+    static IdCache cache;
+    return cache;
+}
+
+class EdgeLog {
+ public:
+    static constexpr size_t kCapacity = 1 << 16;
+
+    void Append(EdgeDelta delta) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        delta.epoch = ++epoch_;
+        log_.push_back(std::move(delta));
+        if (log_.size() > kCapacity) log_.pop_front();
+    }
+
+    int64_t Epoch() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return epoch_;
+    }
+
+    bool Range(int64_t from, int64_t to, std::vector<EdgeDelta>& out) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (from >= to) return true;
+        if (log_.empty() || log_.front().epoch > from + 1) return false;
+        for (auto it = log_.begin() + (from + 1 - log_.front().epoch);
+             it != log_.end() && it->epoch <= to; ++it) {
+            out.push_back(*it);
+        }
+        return true;
+    }
+
+    std::atomic<bool> enabled{false};
+
+ private:
+    std::mutex mutex_;
+    int64_t epoch_ = 0;
+    std::deque<EdgeDelta> log_;
+};
+
+EdgeLog& GetEdgeLog() {
+    static EdgeLog log;
+    return log;
+}
+
+class LoanFlowCache {
+ public:
+    static constexpr size_t kMaxEntries = 1024;
+
+    std::shared_ptr<LoanFlowState> Get(const LoanFlowKey& key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& state = map_[key];
+        if (!state) {
+            // plain bound rather than LRU: the hot loans come back and get recomputed once
+            if (map_.size() > kMaxEntries) {
+                map_.clear();
+                return map_[key] = std::make_shared<LoanFlowState>();
+            }
+            state = std::make_shared<LoanFlowState>();
+        }
+        return state;
+    }
+
+    int64_t Generation() const { return generation_.load(); }
+
+    void Clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        map_.clear();
+        generation_++;
+    }
+
+ private:
+    struct KeyHash {
+        size_t operator()(const LoanFlowKey& k) const {
+            size_t h = std::hash<int64_t>()(k.loan);
+            h = h * 31 + std::hash<int64_t>()(k.start_time);
+            h = h * 31 + std::hash<int64_t>()(k.end_time);
+            h = h * 31 + std::hash<float>()(k.threshold);
+            return h * 31 + std::hash<int64_t>()(k.limit);
+        }
+    };
+
+    std::mutex mutex_;
+    std::unordered_map<LoanFlowKey, std::shared_ptr<LoanFlowState>, KeyHash> map_;
+    std::atomic<int64_t> generation_{0};
+};
+
+LoanFlowCache& GetLoanFlowCache() {
+    static LoanFlowCache cache;
+    return cache;
+}
+
+class EdgeColumnsCache {
+ public:
+    static constexpr size_t kShards = 64;
+
+    EdgeColumnsCache() {
+        const char* mb = std::getenv("FINBENCH_EDGE_CACHE_MB");
+        const char* degree = std::getenv("FINBENCH_EDGE_CACHE_MIN_DEGREE");
+        shard_budget_ = (mb ? std::strtoull(mb, nullptr, 10) : 1024) * (1 << 20) / kShards;
+        min_degree_ = degree ? std::strtoull(degree, nullptr, 10) : 256;
+    }
+
+    int64_t Stamp() const { return stamp_.load(); }
+
+    size_t MinDegree() const { return min_degree_; }
+
+    bool Lookup(int64_t vid, int16_t lid, bool out, int64_t stamp,
+                std::shared_ptr<const EdgeColumns>& columns) {
+        auto& shard = GetShard(vid);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.in_flight > 0) return false;
+        auto it = shard.map.find(vid);
+        if (it == shard.map.end()) return false;
+        for (auto& e : it->second.entries) {
+            if (e.lid == lid && e.out == out && e.since <= stamp) {
+                columns = e.columns;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Insert(int64_t vid, int16_t lid, bool out, int64_t stamp,
+                std::shared_ptr<const EdgeColumns> columns) {
+        size_t bytes = kEntryBytes + columns->Bytes();
+        if (bytes > shard_budget_) return;
+        auto& shard = GetShard(vid);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        // a write to this shard is in flight or was released after the caller's snapshot
+        if (shard.in_flight > 0 || shard.last_write > stamp) return;
+        while (shard.bytes + bytes > shard_budget_ && !shard.fifo.empty()) {
+            auto it = shard.map.find(shard.fifo.front().first);
+            if (it != shard.map.end() && it->second.seq == shard.fifo.front().second) {
+                shard.bytes -= it->second.bytes;
+                shard.map.erase(it);
+            }
+            shard.fifo.pop_front();
+        }
+        auto& vertex = shard.map[vid];
+        if (vertex.entries.empty()) {
+            vertex.seq = ++shard.seq;
+            shard.fifo.emplace_back(vid, vertex.seq);
+            if (shard.fifo.size() > 2 * shard.map.size() + 64) Compact(shard);
+        }
+        for (auto& e : vertex.entries) {
+            if (e.lid == lid && e.out == out) return;
+        }
+        vertex.entries.push_back({lid, out, shard.last_write, std::move(columns)});
+        vertex.bytes += bytes;
+        shard.bytes += bytes;
+    }
+
+    void WriteBegin(const std::vector<int64_t>& vids) {
+        ForShards(vids, [](Shard& shard, const int64_t*) { shard.in_flight++; });
+    }
+
+    void WriteEnd(const std::vector<int64_t>& vids) {
+        ForShards(vids, [this](Shard& shard, const int64_t* vid) {
+            if (vid) {
+                Evict(shard, *vid);
+            } else {
+                shard.map.clear();
+                shard.fifo.clear();
+                shard.bytes = 0;
+            }
+            shard.in_flight--;
+            shard.last_write = ++stamp_;
+        });
+    }
+
+ private:
+    // rough per-entry overhead of the maps
+    static constexpr size_t kEntryBytes = 64;
+
+    struct Entry {
+        int16_t lid;
+        bool out;
+        int64_t since;
+        std::shared_ptr<const EdgeColumns> columns;
+    };
+
+    struct Vertex {
+        std::vector<Entry> entries;
+        size_t bytes = 0;
+        uint64_t seq = 0;
+    };
+
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::unordered_map<int64_t, Vertex> map;
+        // (vid, seq) in insertion order, evicted oldest first; stale once the seq differs
+        std::deque<std::pair<int64_t, uint64_t>> fifo;
+        uint64_t seq = 0;
+        size_t bytes = 0;
+        int in_flight = 0;
+        int64_t last_write = 0;
+    };
+
+    Shard& GetShard(int64_t vid) {
+        uint64_t h = static_cast<uint64_t>(vid) * 0x9E3779B97F4A7C15ull;
+        return shards_[(h >> 32) % kShards];
+    }
+
+    static void Evict(Shard& shard, int64_t vid) {
+        auto it = shard.map.find(vid);
+        if (it == shard.map.end()) return;
+        shard.bytes -= it->second.bytes;
+        shard.map.erase(it);
+    }
+
+    // drops the fifo slots of vertices that were invalidated since they were filled
+    static void Compact(Shard& shard) {
+        std::deque<std::pair<int64_t, uint64_t>> live;
+        for (auto& slot : shard.fifo) {
+            auto it = shard.map.find(slot.first);
+            if (it != shard.map.end() && it->second.seq == slot.second) live.push_back(slot);
+        }
+        shard.fifo.swap(live);
+    }
+
+    // f(shard, vid) under the shard lock, for every vid, or f(shard, nullptr) for every shard
+    template <typename F>
+    void ForShards(const std::vector<int64_t>& vids, F&& f) {
+        if (vids.empty()) {
+            for (auto& shard : shards_) {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                f(shard, nullptr);
+            }
+            return;
+        }
+        for (auto& vid : vids) {
+            auto& shard = GetShard(vid);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            f(shard, &vid);
+        }
+    }
+
+    size_t shard_budget_;
+    size_t min_degree_;
+    std::atomic<int64_t> stamp_{0};
+    std::array<Shard, kShards> shards_;
+};
+
+EdgeColumnsCache& GetEdgeColumnsCache() {
+    static EdgeColumnsCache cache;
+    return cache;
+}
+
+class DegreeStats {
+ public:
+    static constexpr size_t kShards = 64;
+    static constexpr size_t kMaxEntriesPerShard = 1 << 16;
+
+    bool Lookup(int64_t vid, int16_t lid, bool out, uint32_t& degree) {
+        auto& shard = GetShard(vid);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.map.find(Key(vid, lid, out));
+        if (it == shard.map.end()) return false;
+        degree = it->second;
+        return true;
+    }
+
+    void Insert(int64_t vid, int16_t lid, bool out, uint32_t degree) {
+        auto& shard = GetShard(vid);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        if (shard.map.size() >= kMaxEntriesPerShard) shard.map.clear();
+        shard.map[Key(vid, lid, out)] = std::min(degree, kDegreeStatsCap);
+    }
+
+    void Increment(int64_t vid, int16_t lid, bool out) {
+        auto& shard = GetShard(vid);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.map.find(Key(vid, lid, out));
+        if (it != shard.map.end() && it->second < kDegreeStatsCap) it->second++;
+    }
+
+    void Forget(int64_t vid, const std::vector<int16_t>& lids) {
+        auto& shard = GetShard(vid);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        for (auto lid : lids) {
+            shard.map.erase(Key(vid, lid, true));
+            shard.map.erase(Key(vid, lid, false));
+        }
+    }
+
+ private:
+    struct alignas(64) Shard {
+        std::shared_mutex mutex;
+        std::unordered_map<uint64_t, uint32_t> map;
+    };
+
+    // vids fit in 40 bits, which leaves room for the label and direction
+    static uint64_t Key(int64_t vid, int16_t lid, bool out) {
+        return static_cast<uint64_t>(vid) << 17 | static_cast<uint64_t>(uint16_t(lid)) << 1 | out;
+    }
+
+    Shard& GetShard(int64_t vid) {
+        uint64_t h = static_cast<uint64_t>(vid) * 0x9E3779B97F4A7C15ull;
+        return shards_[(h >> 32) % kShards];
+    }
+
+    std::array<Shard, kShards> shards_;
+};
+
+DegreeStats& GetDegreeStats() {
+    static DegreeStats stats;
+    return stats;
+}
+
+/*
+ * Two bits per vid, known and blocked, in pages allocated on first touch. Bits are only set with
+ * fetch_or, and each vid's pair lives in one word, so a reader never sees blocked without known.
+ */
+class BlockedBitmap {
+ public:
+    static constexpr size_t kVidsPerPage = 1 << 16;
+    static constexpr size_t kMaxPages = 1 << 18;
+
+    ~BlockedBitmap() {
+        for (auto& page : pages_) delete[] page.load();
+    }
+
+    bool Lookup(int64_t vid, bool& blocked) {
+        auto* word = Word(vid, false);
+        if (!word) return false;
+        uint64_t bits = word->load(std::memory_order_acquire) >> Shift(vid);
+        if (!(bits & 1)) return false;
+        blocked = bits & 2;
+        return true;
+    }
+
+    void Record(int64_t vid, bool blocked) {
+        auto* word = Word(vid, true);
+        if (word) word->fetch_or((blocked ? 3ull : 1ull) << Shift(vid), std::memory_order_release);
+    }
+
+    void Forget(int64_t vid) {
+        auto* word = Word(vid, false);
+        if (word) word->fetch_and(~(3ull << Shift(vid)), std::memory_order_release);
+    }
+
+    std::once_flag loaded;
+
+ private:
+    typedef std::atomic<uint64_t> Page[kVidsPerPage / 32];
+
+    static size_t Shift(int64_t vid) { return (vid % 32) * 2; }
+
+    std::atomic<uint64_t>* Word(int64_t vid, bool create) {
+        if (vid < 0 || static_cast<uint64_t>(vid) >= kVidsPerPage * kMaxPages) return nullptr;
+        auto& slot = pages_[vid / kVidsPerPage];
+        auto* page = slot.load(std::memory_order_acquire);
+        if (!page) {
+            if (!create) return nullptr;
+            auto* fresh = new Page[1]();
+            if (slot.compare_exchange_strong(page, fresh, std::memory_order_acq_rel)) {
+                page = fresh;
+            } else {
+                delete[] fresh;
+            }
+        }
+        return &(*page)[vid % kVidsPerPage / 32];
+    }
+
+    std::array<std::atomic<Page*>, kMaxPages> pages_{};
+};
+
+BlockedBitmap& GetBlockedBitmap() {
+    static BlockedBitmap bitmap;
+    return bitmap;
+}
+
+struct BoundSchema {
+    std::once_flag bound;
+    SchemaIds ids;
+};
+
+BoundSchema& GetBoundSchema() {
+    static BoundSchema schema;
+    return schema;
+}
+
+}  // namespace
+
+bool IdCacheLookup(IdSpace space, int64_t id, int64_t& vid) {
+    return GetIdCache().Lookup(space, id, vid);
+}
+
+void IdCacheInsert(IdSpace space, int64_t id, int64_t vid) { GetIdCache().Insert(space, id, vid); }
+
+void IdCacheErase(IdSpace space, int64_t id) { GetIdCache().Erase(space, id); }
+
+void IdCacheClear() { GetIdCache().Clear(); }
+
+void EdgeLogEnable() { GetEdgeLog().enabled.store(true); }
+
+bool EdgeLogEnabled() { return GetEdgeLog().enabled.load(std::memory_order_relaxed); }
+
+int64_t EdgeLogEpoch() { return GetEdgeLog().Epoch(); }
+
+void EdgeLogAppend(const lgraph_api::EdgeUid& uid, int64_t ts, double amount) {
+    GetEdgeLog().Append(EdgeDelta{0, uid.src, uid.dst, uid.lid, uid.tid, uid.eid, ts, amount});
+}
+
+bool EdgeLogRange(int64_t from, int64_t to, std::vector<EdgeDelta>& out) {
+    return GetEdgeLog().Range(from, to, out);
+}
+
+std::shared_ptr<LoanFlowState> LoanFlowCacheGet(const LoanFlowKey& key) {
+    return GetLoanFlowCache().Get(key);
+}
+
+int64_t LoanFlowCacheGeneration() { return GetLoanFlowCache().Generation(); }
+
+void LoanFlowCacheClear() { GetLoanFlowCache().Clear(); }
+
+int64_t LoanFlowScratchLimit() {
+    static const int64_t limit = []() -> int64_t {
+        const char* mb = std::getenv("FINBENCH_TCR8_SCRATCH_MB");
+        return mb ? std::strtoll(mb, nullptr, 10) * (1 << 20) : -1;
+    }();
+    return limit;
+}
+
+int64_t EdgeColumnsStamp() { return GetEdgeColumnsCache().Stamp(); }
+
+size_t EdgeColumnsMinDegree() { return GetEdgeColumnsCache().MinDegree(); }
+
+bool EdgeColumnsLookup(int64_t vid, int16_t lid, bool out, int64_t stamp,
+                       std::shared_ptr<const EdgeColumns>& columns) {
+    return GetEdgeColumnsCache().Lookup(vid, lid, out, stamp, columns);
+}
+
+void EdgeColumnsInsert(int64_t vid, int16_t lid, bool out, int64_t stamp,
+                       std::shared_ptr<const EdgeColumns> columns) {
+    GetEdgeColumnsCache().Insert(vid, lid, out, stamp, std::move(columns));
+}
+
+void EdgeColumnsWriteBegin(const std::vector<int64_t>& vids) {
+    GetEdgeColumnsCache().WriteBegin(vids);
+}
+
+void EdgeColumnsWriteEnd(const std::vector<int64_t>& vids) {
+    GetEdgeColumnsCache().WriteEnd(vids);
+}
+
+bool DegreeStatsLookup(int64_t vid, int16_t lid, bool out, uint32_t& degree) {
+    return GetDegreeStats().Lookup(vid, lid, out, degree);
+}
+
+void DegreeStatsInsert(int64_t vid, int16_t lid, bool out, uint32_t degree) {
+    GetDegreeStats().Insert(vid, lid, out, degree);
+}
+
+void DegreeStatsAddEdge(int64_t src, int64_t dst, int16_t lid) {
+    GetDegreeStats().Increment(src, lid, true);
+    GetDegreeStats().Increment(dst, lid, false);
+}
+
+void DegreeStatsForget(int64_t vid, const std::vector<int16_t>& lids) {
+    GetDegreeStats().Forget(vid, lids);
+}
+
+void BlockedLoadOnce(const std::function<void()>& load) {
+    std::call_once(GetBlockedBitmap().loaded, load);
+}
+
+bool BlockedLookup(int64_t vid, bool& blocked) { return GetBlockedBitmap().Lookup(vid, blocked); }
+
+void BlockedRecord(int64_t vid, bool blocked) { GetBlockedBitmap().Record(vid, blocked); }
+
+void BlockedForget(int64_t vid) { GetBlockedBitmap().Forget(vid); }
+
+const SchemaIds& SchemaBindOnce(const std::function<void(SchemaIds&)>& bind) {
+    auto& schema = GetBoundSchema();
+    std::call_once(schema.bound, bind, std::ref(schema.ids));
+    return schema.ids;
+}
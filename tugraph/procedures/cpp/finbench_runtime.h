@@ -0,0 +1,345 @@
+/**
+ * Copyright 2022 AntGroup CO., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ */
+
+/*
+ * Process-wide state shared by all finbench plugins.
+ *
+ * Every plugin is a separate shared object, so a static variable in a header would give each
+ * plugin its own copy. The state below is defined once in finbench_runtime.cpp, built into
+ * libfinbench_runtime.so, and every plugin links against that library, so the dynamic loader maps
+ * a single instance into the server process.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "lgraph/lgraph.h"
+
+// Kind of external id, i.e. the vertex label whose primary key is the id.
+enum class IdSpace : uint8_t { kPerson = 0, kCompany = 1, kAccount = 2, kLoan = 3, kMedium = 4 };
+
+/*
+ * Label and field ids of the finbench schema, resolved by the first plugin call (or warm-up, see
+ * WarmUp in finbench_plugin.h) instead of by name on every call. Like the caches below, they
+ * assume the graph is not re-imported under a running server.
+ */
+struct SchemaIds {
+    // indexed by IdSpace
+    uint16_t vertex_label[5];
+    size_t id_field[5];
+    int16_t transfer, withdraw, deposit, repay, guarantee, apply, invest;
+};
+// Runs `bind` once per process; concurrent first callers wait for it.
+const SchemaIds& SchemaBindOnce(const std::function<void(SchemaIds&)>& bind);
+
+inline const SchemaIds& Schema(lgraph_api::Transaction& txn) {
+    return SchemaBindOnce([&txn](SchemaIds& ids) {
+        static const char* VERTEX_LABELS[] = {"Person", "Company", "Account", "Loan", "Medium"};
+        for (size_t i = 0; i < 5; i++) {
+            ids.vertex_label[i] = (uint16_t)txn.GetVertexLabelId(VERTEX_LABELS[i]);
+            ids.id_field[i] = txn.GetVertexFieldId(ids.vertex_label[i], "id");
+        }
+        ids.transfer = (int16_t)txn.GetEdgeLabelId("transfer");
+        ids.withdraw = (int16_t)txn.GetEdgeLabelId("withdraw");
+        ids.deposit = (int16_t)txn.GetEdgeLabelId("deposit");
+        ids.repay = (int16_t)txn.GetEdgeLabelId("repay");
+        ids.guarantee = (int16_t)txn.GetEdgeLabelId("guarantee");
+        ids.apply = (int16_t)txn.GetEdgeLabelId("apply");
+        ids.invest = (int16_t)txn.GetEdgeLabelId("invest");
+    });
+}
+
+/*
+ * External id -> vid cache. Reads take a shared lock on one of many shards, so concurrent plugin
+ * calls rarely contend. Entries are never trusted blindly: GetVertexById re-checks label and id on
+ * every hit, so vertices deleted outside of the plugins (e.g. through Cypher) just miss.
+ */
+bool IdCacheLookup(IdSpace space, int64_t id, int64_t& vid);
+void IdCacheInsert(IdSpace space, int64_t id, int64_t vid);
+void IdCacheErase(IdSpace space, int64_t id);
+void IdCacheClear();
+
+// Resolves a vertex by its primary id, through the cache when possible.
+inline lgraph_api::VertexIterator GetVertexById(lgraph_api::Transaction& txn, IdSpace space,
+                                                const std::string& label,
+                                                const std::string& id_field, int64_t id) {
+    int64_t vid;
+    if (IdCacheLookup(space, id, vid)) {
+        const SchemaIds& schema = Schema(txn);
+        auto s = static_cast<size_t>(space);
+        auto vit = txn.GetVertexIterator(vid);
+        if (vit.IsValid() && vit.GetLabelId() == schema.vertex_label[s] &&
+            vit.GetField(schema.id_field[s]).AsInt64() == id) {
+            return vit;
+        }
+        IdCacheErase(space, id);
+    }
+    auto vit = txn.GetVertexByUniqueIndex(label, id_field, lgraph_api::FieldData(id));
+    if (vit.IsValid()) IdCacheInsert(space, id, vit.GetId());
+    return vit;
+}
+
+/*
+ * Log of committed transfer/withdraw/deposit inserts, used to bring materialized results up to
+ * date. Every append gets the next epoch; a result computed from a snapshot taken after reading
+ * epoch E has seen every edge up to E and replays the later ones. The log is bounded, so a result
+ * that falls behind its tail has to be recomputed. Appends are skipped until the first reader
+ * enables the log, so the write plugins pay nothing when materialization is not used.
+ */
+struct EdgeDelta {
+    int64_t epoch;
+    int64_t src, dst;
+    uint16_t lid;
+    // the rest of the EdgeUid
+    int64_t tid, eid;
+    int64_t ts;
+    double amount;
+};
+
+void EdgeLogEnable();
+bool EdgeLogEnabled();
+int64_t EdgeLogEpoch();
+void EdgeLogAppend(const lgraph_api::EdgeUid& uid, int64_t ts, double amount);
+// Appends to `out` the entries with epoch in (from, to]. False if some were already dropped.
+bool EdgeLogRange(int64_t from, int64_t to, std::vector<EdgeDelta>& out);
+
+// Materialized tcr8 state of one loan and parameter set, see tcr8.cpp.
+struct LoanFlowKey {
+    int64_t loan;
+    int64_t start_time, end_time;
+    float threshold;
+    int64_t limit;
+
+    bool operator==(const LoanFlowKey& o) const {
+        return loan == o.loan && start_time == o.start_time && end_time == o.end_time &&
+               threshold == o.threshold && limit == o.limit;
+    }
+};
+
+// An edge of the flow: its EdgeUid with both ends as local ids of a LoanFlowState.
+struct LoanFlowEdgeKey {
+    uint32_t src, dst;
+    uint16_t lid;
+    int64_t tid, eid;
+
+    bool operator==(const LoanFlowEdgeKey& o) const {
+        return src == o.src && dst == o.dst && lid == o.lid && tid == o.tid && eid == o.eid;
+    }
+};
+
+struct LoanFlowEdgeKeyHash {
+    size_t operator()(const LoanFlowEdgeKey& k) const {
+        uint64_t h = (uint64_t)k.src << 32 | k.dst;
+        h = (h ^ (uint64_t)k.lid) * 0x9E3779B97F4A7C15ull;
+        h = (h ^ (uint64_t)k.tid) * 0x9E3779B97F4A7C15ull;
+        return (h ^ (uint64_t)k.eid) * 0x9E3779B97F4A7C15ull;
+    }
+};
+
+struct LoanFlowEdge {
+    double amount;
+    // first hop that reached the edge
+    uint32_t hop;
+};
+
+struct LoanFlowState {
+    std::mutex mutex;
+    bool valid = false;
+    int64_t epoch = 0;
+    // vertices reached at each hop, hop 0 being the deposit targets; ascending
+    std::vector<int64_t> frontiers[4];
+    // every vertex seen gets a 32-bit local id, which indexes `vids` and `min_amount`
+    std::unordered_map<int64_t, uint32_t> local_ids;
+    std::vector<int64_t> vids;
+    std::vector<double> min_amount;
+    // edges above the threshold, with their amount and hop
+    std::unordered_map<LoanFlowEdgeKey, LoanFlowEdge, LoanFlowEdgeKeyHash> merged_in;
+
+    void Clear() {
+        for (auto& f : frontiers) f.clear();
+        local_ids.clear();
+        vids.clear();
+        min_amount.clear();
+        merged_in.clear();
+    }
+
+    /*
+     * Heap footprint of the containers, counting a node, its cached hash and next pointer, and a
+     * bucket per hash map entry. With `grow`, as it would be after one more vertex and edge,
+     * including the reallocation or rehash this may trigger.
+     */
+    size_t Bytes(bool grow = false) const {
+        constexpr size_t kNode = 3 * sizeof(void*);
+        auto vector = [grow](size_t size, size_t capacity, size_t item) {
+            return (grow && size == capacity ? std::max<size_t>(2 * capacity, 1) : capacity) * item;
+        };
+        auto map = [grow](const auto& m, size_t item) {
+            size_t buckets = m.bucket_count();
+            if (grow && m.size() + 1 > buckets * m.max_load_factor()) buckets *= 2;
+            return (m.size() + grow) * (item + kNode) + buckets * sizeof(void*);
+        };
+        size_t bytes = 0;
+        for (auto& f : frontiers) bytes += vector(f.size(), f.capacity(), sizeof(int64_t));
+        bytes += map(local_ids, sizeof(std::pair<int64_t, uint32_t>));
+        bytes += vector(vids.size(), vids.capacity(), sizeof(int64_t));
+        bytes += vector(min_amount.size(), min_amount.capacity(), sizeof(double));
+        bytes += map(merged_in, sizeof(std::pair<LoanFlowEdgeKey, LoanFlowEdge>));
+        return bytes;
+    }
+};
+
+/*
+ * Default cap on the scratch bytes of one tcr8 call, from FINBENCH_TCR8_SCRATCH_MB; unbounded
+ * when unset. A "maxScratchBytes" in the request takes precedence.
+ */
+int64_t LoanFlowScratchLimit();
+
+// Returns the state for `key`, creating an empty (invalid) one if needed.
+std::shared_ptr<LoanFlowState> LoanFlowCacheGet(const LoanFlowKey& key);
+/*
+ * Deletes are not logged, so tw17 drops every state once before and once after committing; every
+ * clear bumps the generation, which is therefore odd while a delete is in flight. A reader keeps
+ * a state only if the generation taken before its snapshot is even and unchanged at the end of
+ * its call.
+ */
+int64_t LoanFlowCacheGeneration();
+void LoanFlowCacheClear();
+
+/*
+ * Cache of the (other end, timestamp, amount) columns of the transfer/withdraw/deposit adjacency
+ * of high-degree vertices, see AdjacencyColumns in finbench_plugin.h. Only labels whose inserts
+ * and deletes all go through the plugins may be cached; repay is still written through Cypher.
+ *
+ * Coherence: readers take EdgeColumnsStamp() before opening their transaction. Plugins that
+ * commit edges of cached labels hold an EdgeColumnsWriteGuard over the commit. While a guard is
+ * held on a vertex, its entries are neither served nor filled. When the guard is released they
+ * are dropped, and a reader whose stamp predates the release cannot use or fill them. A reader
+ * therefore only ever sees columns that match its own snapshot.
+ *
+ * The size is bounded by FINBENCH_EDGE_CACHE_MB (default 1024) and the oldest vertices are
+ * evicted first. Labels with fewer than FINBENCH_EDGE_CACHE_MIN_DEGREE (default 256) edges are
+ * not cached, so they do not take the budget from the hubs.
+ */
+struct EdgeColumns {
+    // newest first; `tid` and `eid` complete the EdgeUid
+    std::vector<int64_t> other;
+    std::vector<int64_t> ts;
+    std::vector<double> amount;
+    std::vector<int64_t> tid;
+    std::vector<int64_t> eid;
+
+    size_t Size() const { return ts.size(); }
+    size_t Bytes() const { return sizeof(*this) + Size() * (4 * sizeof(int64_t) + sizeof(double)); }
+};
+
+int64_t EdgeColumnsStamp();
+size_t EdgeColumnsMinDegree();
+// True on a hit.
+bool EdgeColumnsLookup(int64_t vid, int16_t lid, bool out, int64_t stamp,
+                       std::shared_ptr<const EdgeColumns>& columns);
+void EdgeColumnsInsert(int64_t vid, int16_t lid, bool out, int64_t stamp,
+                       std::shared_ptr<const EdgeColumns> columns);
+// An empty vids covers every vertex, for deletes whose neighbours are not tracked.
+void EdgeColumnsWriteBegin(const std::vector<int64_t>& vids);
+void EdgeColumnsWriteEnd(const std::vector<int64_t>& vids);
+
+class EdgeColumnsWriteGuard {
+ public:
+    explicit EdgeColumnsWriteGuard(std::vector<int64_t> vids) : vids_(std::move(vids)) {
+        EdgeColumnsWriteBegin(vids_);
+    }
+    ~EdgeColumnsWriteGuard() { EdgeColumnsWriteEnd(vids_); }
+    EdgeColumnsWriteGuard(const EdgeColumnsWriteGuard&) = delete;
+    EdgeColumnsWriteGuard& operator=(const EdgeColumnsWriteGuard&) = delete;
+
+ private:
+    std::vector<int64_t> vids_;
+};
+
+/*
+ * Per-vertex edge counts by label and direction, for choosing which side of a two-sided search
+ * to expand (see PlanCycleReversed in finbench_plugin.h). Readers fill them on first use, counting
+ * up to kDegreeStatsCap edges; the write plugins bump both ends after each committed insert and
+ * tw17 drops those of the vertices it deletes and of their neighbours. An insert racing with a
+ * fill may be counted twice or not at all, which only ever affects a plan, never a result.
+ */
+constexpr uint32_t kDegreeStatsCap = 1 << 12;
+
+bool DegreeStatsLookup(int64_t vid, int16_t lid, bool out, uint32_t& degree);
+void DegreeStatsInsert(int64_t vid, int16_t lid, bool out, uint32_t degree);
+// Bumps the counts of src (out) and dst (in) that are already known.
+void DegreeStatsAddEdge(int64_t src, int64_t dst, int16_t lid);
+// Drops the counts of vid for `lids` in both directions.
+void DegreeStatsForget(int64_t vid, const std::vector<int16_t>& lids);
+
+/*
+ * isBlocked of Account, Person and Medium vertices, as a "known" and a "blocked" bit per vid. The
+ * first plugin call scans those labels once; vertices created later are read from their property
+ * on first use and recorded. The plugins that set isBlocked record it before committing (see
+ * CommitBlocked), so no write transaction that starts after theirs can read a stale "not
+ * blocked", and forget it again if the commit fails. isBlocked is never reset, so the bits only
+ * ever get set, except by tw17 forgetting the vids it deletes and by failed commits. As with the
+ * edge columns, isBlocked must only be set through the plugins (trw1-3, tw18, tw19), not through
+ * Cypher.
+ */
+// Runs `load` once per process; concurrent first callers wait for it.
+void BlockedLoadOnce(const std::function<void()>& load);
+// False if vid is not known and has to be read from the vertex.
+bool BlockedLookup(int64_t vid, bool& blocked);
+void BlockedRecord(int64_t vid, bool blocked);
+void BlockedForget(int64_t vid);
+
+inline void BlockedLoad(lgraph_api::GraphDB& db) {
+    BlockedLoadOnce([&db]() {
+        static const std::string IS_BLOCKED = "isBlocked";
+        auto txn = db.CreateReadTxn();
+        std::vector<size_t> lids = {txn.GetVertexLabelId("Account"),
+                                    txn.GetVertexLabelId("Person"),
+                                    txn.GetVertexLabelId("Medium")};
+        for (auto vit = txn.GetVertexIterator(); vit.IsValid(); vit.Next()) {
+            if (std::find(lids.begin(), lids.end(), vit.GetLabelId()) == lids.end()) continue;
+            BlockedRecord(vit.GetId(), vit.GetField(IS_BLOCKED).AsBool());
+        }
+    });
+}
+
+// isBlocked of the vertex `vit` is on, from the bitmap when known.
+inline bool IsBlocked(lgraph_api::VertexIterator& vit) {
+    static const std::string IS_BLOCKED = "isBlocked";
+    bool blocked;
+    if (BlockedLookup(vit.GetId(), blocked)) return blocked;
+    blocked = vit.GetField(IS_BLOCKED).AsBool();
+    BlockedRecord(vit.GetId(), blocked);
+    return blocked;
+}
+
+// Commits a transaction that set isBlocked on `vids`, keeping the bitmap ahead of the commit.
+inline void CommitBlocked(lgraph_api::Transaction& txn, const std::vector<int64_t>& vids) {
+    for (auto vid : vids) BlockedRecord(vid, true);
+    try {
+        txn.Commit();
+    } catch (...) {
+        // unknown again, so the next caller reads the property
+        for (auto vid : vids) BlockedForget(vid);
+        throw;
+    }
+}
@@ -0,0 +1,223 @@
+/**
+ * Copyright 2022 AntGroup CO., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ */
+
+/*
+ * Vectorized kernels shared by the plugins. This header does not depend on lgraph so that the
+ * kernels can be benchmarked standalone (see procedures/bench). The AVX2 paths are compiled with a
+ * per-function target attribute and picked at runtime, so the plugins do not need -mavx2.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define FINBENCH_HAS_AVX2_PATH 1
+#include <immintrin.h>
+#endif
+
+// Number of common elements of two ascending, deduplicated id arrays.
+inline size_t IntersectSortedCountScalar(const int64_t* a, size_t na, const int64_t* b,
+                                         size_t nb) {
+    size_t i = 0, j = 0, count = 0;
+    while (i < na && j < nb) {
+        if (a[i] < b[j]) {
+            i++;
+        } else if (a[i] > b[j]) {
+            j++;
+        } else {
+            count++;
+            i++;
+            j++;
+        }
+    }
+    return count;
+}
+
+#ifdef FINBENCH_HAS_AVX2_PATH
+// Block-wise merge: every 4-wide block of a is compared against every rotation of the current
+// 4-wide block of b, then the block with the smaller maximum is advanced. Each equal pair lies in
+// exactly one visited block pair, so matches are counted once.
+__attribute__((target("avx2"))) inline size_t IntersectSortedCountAvx2(const int64_t* a,
+                                                                        size_t na,
+                                                                        const int64_t* b,
+                                                                        size_t nb) {
+    size_t i = 0, j = 0, count = 0;
+    const size_t na4 = na & ~size_t(3), nb4 = nb & ~size_t(3);
+    while (i < na4 && j < nb4) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + j));
+        __m256i m = _mm256_cmpeq_epi64(va, vb);
+        vb = _mm256_permute4x64_epi64(vb, 0x39);
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi64(va, vb));
+        vb = _mm256_permute4x64_epi64(vb, 0x39);
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi64(va, vb));
+        vb = _mm256_permute4x64_epi64(vb, 0x39);
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi64(va, vb));
+        count += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(m)));
+        const int64_t amax = a[i + 3], bmax = b[j + 3];
+        if (amax <= bmax) i += 4;
+        if (bmax <= amax) j += 4;
+    }
+    return count + IntersectSortedCountScalar(a + i, na - i, b + j, nb - j);
+}
+#endif
+
+inline size_t IntersectSortedCount(const int64_t* a, size_t na, const int64_t* b, size_t nb) {
+#ifdef FINBENCH_HAS_AVX2_PATH
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    // the block compare only pays off once both sides span a few blocks
+    if (has_avx2 && na >= 16 && nb >= 16) return IntersectSortedCountAvx2(a, na, b, nb);
+#endif
+    return IntersectSortedCountScalar(a, na, b, nb);
+}
+
+// |A∩B| / |A∪B| of two ascending, deduplicated id vectors, 0 when both are empty.
+inline double JaccardSimilarity(const std::vector<int64_t>& a, const std::vector<int64_t>& b) {
+    size_t inter = IntersectSortedCount(a.data(), a.size(), b.data(), b.size());
+    size_t uni = a.size() + b.size() - inter;
+    return uni == 0 ? 0.0 : static_cast<double>(inter) / uni;
+}
+
+// Window predicate of the edge scans: start < ts < end and amount > min_amount.
+inline bool InWindow(int64_t ts, double amount, int64_t start, int64_t end, double min_amount) {
+    return ts > start && ts < end && amount > min_amount;
+}
+
+inline size_t FilterWindowScalar(const int64_t* ts, const double* amount, size_t n, int64_t start,
+                                 int64_t end, double min_amount, uint32_t* out) {
+    size_t k = 0;
+    for (size_t i = 0; i < n; i++) {
+        out[k] = static_cast<uint32_t>(i);
+        k += InWindow(ts[i], amount[i], start, end, min_amount);
+    }
+    return k;
+}
+
+inline size_t CountWindowScalar(const int64_t* ts, const double* amount, size_t n, int64_t start,
+                                int64_t end, double min_amount) {
+    size_t k = 0;
+    for (size_t i = 0; i < n; i++) k += InWindow(ts[i], amount[i], start, end, min_amount);
+    return k;
+}
+
+inline double SumWindowScalar(const int64_t* ts, const double* amount, size_t n, int64_t start,
+                              int64_t end, double min_amount) {
+    double sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (InWindow(ts[i], amount[i], start, end, min_amount)) sum += amount[i];
+    }
+    return sum;
+}
+
+#ifdef FINBENCH_HAS_AVX2_PATH
+// 4-lane mask of the window predicate; int64 compares are signed, as are the timestamps.
+__attribute__((target("avx2"))) inline __m256i WindowMaskAvx2(const int64_t* ts,
+                                                               const double* amount,
+                                                               __m256i vstart, __m256i vend,
+                                                               __m256d vmin) {
+    __m256i t = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ts));
+    __m256i m = _mm256_and_si256(_mm256_cmpgt_epi64(t, vstart), _mm256_cmpgt_epi64(vend, t));
+    __m256d a = _mm256_cmp_pd(_mm256_loadu_pd(amount), vmin, _CMP_GT_OQ);
+    return _mm256_and_si256(m, _mm256_castpd_si256(a));
+}
+
+__attribute__((target("avx2"))) inline size_t FilterWindowAvx2(const int64_t* ts,
+                                                                const double* amount, size_t n,
+                                                                int64_t start, int64_t end,
+                                                                double min_amount, uint32_t* out) {
+    const __m256i vstart = _mm256_set1_epi64x(start), vend = _mm256_set1_epi64x(end);
+    const __m256d vmin = _mm256_set1_pd(min_amount);
+    size_t i = 0, k = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i m = WindowMaskAvx2(ts + i, amount + i, vstart, vend, vmin);
+        unsigned bits = _mm256_movemask_pd(_mm256_castsi256_pd(m));
+        while (bits) {
+            out[k++] = static_cast<uint32_t>(i + __builtin_ctz(bits));
+            bits &= bits - 1;
+        }
+    }
+    for (; i < n; i++) {
+        out[k] = static_cast<uint32_t>(i);
+        k += InWindow(ts[i], amount[i], start, end, min_amount);
+    }
+    return k;
+}
+
+__attribute__((target("avx2"))) inline size_t CountWindowAvx2(const int64_t* ts,
+                                                               const double* amount, size_t n,
+                                                               int64_t start, int64_t end,
+                                                               double min_amount) {
+    const __m256i vstart = _mm256_set1_epi64x(start), vend = _mm256_set1_epi64x(end);
+    const __m256d vmin = _mm256_set1_pd(min_amount);
+    size_t i = 0, k = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i m = WindowMaskAvx2(ts + i, amount + i, vstart, vend, vmin);
+        k += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(m)));
+    }
+    return k + CountWindowScalar(ts + i, amount + i, n - i, start, end, min_amount);
+}
+
+__attribute__((target("avx2"))) inline double SumWindowAvx2(const int64_t* ts,
+                                                             const double* amount, size_t n,
+                                                             int64_t start, int64_t end,
+                                                             double min_amount) {
+    const __m256i vstart = _mm256_set1_epi64x(start), vend = _mm256_set1_epi64x(end);
+    const __m256d vmin = _mm256_set1_pd(min_amount);
+    __m256d vsum = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i m = WindowMaskAvx2(ts + i, amount + i, vstart, vend, vmin);
+        vsum = _mm256_add_pd(vsum, _mm256_and_pd(_mm256_loadu_pd(amount + i),
+                                                 _mm256_castsi256_pd(m)));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, vsum);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+           SumWindowScalar(ts + i, amount + i, n - i, start, end, min_amount);
+}
+#endif
+
+// Writes to `out` the ascending positions of the edges in the window and returns their number.
+// `out` must have room for n entries.
+inline size_t FilterWindow(const int64_t* ts, const double* amount, size_t n, int64_t start,
+                           int64_t end, double min_amount, uint32_t* out) {
+#ifdef FINBENCH_HAS_AVX2_PATH
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    if (has_avx2) return FilterWindowAvx2(ts, amount, n, start, end, min_amount, out);
+#endif
+    return FilterWindowScalar(ts, amount, n, start, end, min_amount, out);
+}
+
+inline size_t CountWindow(const int64_t* ts, const double* amount, size_t n, int64_t start,
+                          int64_t end, double min_amount) {
+#ifdef FINBENCH_HAS_AVX2_PATH
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    if (has_avx2) return CountWindowAvx2(ts, amount, n, start, end, min_amount);
+#endif
+    return CountWindowScalar(ts, amount, n, start, end, min_amount);
+}
+
+// Sum of the amounts in the window. The AVX2 path adds in a different order than the scalar one.
+inline double SumWindow(const int64_t* ts, const double* amount, size_t n, int64_t start,
+                        int64_t end, double min_amount) {
+#ifdef FINBENCH_HAS_AVX2_PATH
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    if (has_avx2) return SumWindowAvx2(ts, amount, n, start, end, min_amount);
+#endif
+    return SumWindowScalar(ts, amount, n, start, end, min_amount);
+}
@@ -0,0 +1,82 @@
+/**
+ * Copyright 2022 AntGroup CO., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <iostream>
+#include <vector>
+#include "lgraph/lgraph.h"
+#include "lgraph/lgraph_types.h"
+#include "lgraph/lgraph_utils.h"
+#include "lgraph/lgraph_result.h"
+#include "tools/json.hpp"
+#include "finbench_plugin.h"
+#include "finbench_runtime.h"
+#include "finbench_simd.h"
+
+using namespace lgraph_api;
+using json = nlohmann::json;
+
+extern "C" bool Process(GraphDB& db, const std::string& request, std::string& response) {
+    static const std::string PERSON_LABEL = "Person";
+    static const std::string PERSON_ID = "id";
+    static const std::string INVEST_TIMESTAMP = "timestamp";
+    json output;
+    int64_t pid1, pid2, start_time, end_time;
+    try {
+        json input = json::parse(request);
+        if (input.contains("warmup")) {
+            return WarmUp(db, input["warmup"].value("top", (int64_t)0), response);
+        }
+        parse_from_json(pid1, "pid1", input);
+        parse_from_json(pid2, "pid2", input);
+        parse_from_json(start_time, "startTime", input);
+        parse_from_json(end_time, "endTime", input);
+    } catch (std::exception& e) {
+        output["msg"] = "json parse error: " + std::string(e.what());
+        response = output.dump();
+        return false;
+    }
+    auto txn = db.CreateReadTxn();
+    std::vector<int16_t> invest_id = {
+        Schema(txn).invest,
+    };
+    // distinct invest targets in the window, as ascending vids
+    auto collect_invest = [&](int64_t pid, std::vector<int64_t>& vids) {
+        auto person = GetVertexById(txn, IdSpace::kPerson, PERSON_LABEL, PERSON_ID, pid);
+        // a missing person invests in nothing, so the similarity is 0, as collect() over no
+        // matches gives in the Cypher version
+        if (!person.IsValid()) return;
+        for (auto eit = LabeledOutEdgeIterator(person.GetOutEdgeIterator(), person.GetId(), 0,
+                                               invest_id, -1);
+             eit.IsValid(); eit.Next()) {
+            auto ts = eit.Eit().GetField(INVEST_TIMESTAMP).AsInt64();
+            if (ts > start_time && ts < end_time) {
+                vids.push_back(eit.Eit().GetDst());
+            }
+        }
+        std::sort(vids.begin(), vids.end());
+        vids.erase(std::unique(vids.begin(), vids.end()), vids.end());
+    };
+    std::vector<int64_t> m1_vids, m2_vids;
+    collect_invest(pid1, m1_vids);
+    collect_invest(pid2, m2_vids);
+    double similarity = JaccardSimilarity(m1_vids, m2_vids);
+    lgraph_api::Result api_result({{"similarity", LGraphType::DOUBLE}});
+    auto& r = api_result.NewRecord();
+    r.Insert("similarity", FieldData::Double(std::round(similarity * 1000) / 1000));
+    response = api_result.Dump();
+    return true;
+}
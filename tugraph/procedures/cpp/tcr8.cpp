@@ -15,8 +15,8 @@
 #include <algorithm>
 #include <exception>
 #include <iostream>
+#include <limits>
 #include <unordered_map>
-#include <unordered_set>
 #include <utility>
 #include "lgraph/lgraph.h"
 #include "lgraph/lgraph_edge_iterator.h"
@@ -24,194 +24,359 @@
 #include "lgraph/lgraph_utils.h"
 #include "lgraph/lgraph_result.h"
 #include "tools/json.hpp"
+#include "finbench_plugin.h"
+#include "finbench_runtime.h"
 
 using namespace lgraph_api;
 using json = nlohmann::json;
 
-template <typename EIT>
-class LabeledEdgeIterator {
- public:
-    LabeledEdgeIterator(EIT&& eit, const int64_t src, const int64_t dst,
-                        const std::vector<int16_t>& lids, int64_t per_node_limit)
-        : eit_(std::move(eit)) {
-        if (lids.empty()) {
-            valid_ = false;
-            return;
-        }
-        valid_ = true;
-        lid_pos_ = 0;
-        lids_ = lids;
-        src_ = src;
-        dst_ = dst;
-        per_node_limit_ = per_node_limit;
-        count_ = 1;
-        eit_.Goto(EdgeUid(src_, dst_, lids_[lid_pos_], 0, 0), true);
-        while (!_IsCurLabelValid() && _NextLabel()) {
-        }
-    }
-
-    bool IsValid() { return valid_; }
-
-    void Next() {
-        count_ += 1;
-        eit_.Next();
-        while (!_IsCurLabelValid() && _NextLabel()) {
-        }
-    }
-
-    EdgeUid GetUid() { return eit_.GetUid(); }
-
-    EIT& Eit() { return eit_; }
-
- private:
-    bool _IsCurLabelValid() {
-        return lid_pos_ < lids_.size() && eit_.IsValid() && eit_.GetLabelId() == lids_[lid_pos_] &&
-               (per_node_limit_ < 0 || count_ <= per_node_limit_);
-    }
-
-    bool _NextLabel() {
-        count_ = 1;
-        if (++lid_pos_ >= lids_.size()) {
-            valid_ = false;
-            return valid_;
-        }
-        eit_.Goto(EdgeUid(src_, dst_, lids_[lid_pos_], 0, 0), true);
-        return true;
-    }
-
-    EIT eit_;
-    bool valid_;
-    int64_t src_, dst_;
-    int64_t per_node_limit_;
-    size_t count_;
-    size_t lid_pos_;
-    std::vector<int16_t> lids_;
-};
-
-typedef LabeledEdgeIterator<OutEdgeIterator> LabeledOutEdgeIterator;
-typedef LabeledEdgeIterator<InEdgeIterator> LabeledInEdgeIterator;
-
+/*
+ * With "materialize": true the per-hop frontiers and merged_in aggregates are kept in the process-
+ * wide LoanFlowCache, keyed by loan and parameters. A later call replays the transfer, withdraw and
+ * deposit inserts logged by the write plugins since then, expanding only vertices that newly join a
+ * frontier, instead of redoing the three-hop expansion. Inserts that may push an older edge out of
+ * a truncated adjacency cannot be replayed and fall back to a full recomputation. So does replay
+ * reaching a vertex with an amount other than its recorded first amount: a fresh run might have
+ * seen that edge first, and the first amount decides which later edges pass the threshold. Every
+ * other replay leaves the first amounts, and so the rows, as a fresh run would.
+ *
+ * With "topk": K only the first K rows of the result order are returned. They are selected with a
+ * bounded heap while the rows are built, so accounts that cannot enter it are never looked up.
+ *
+ * "maxEdges", "maxVertices" and "timeoutMs" bound the expansion (see WorkBudget). A call that runs
+ * out returns false with msg "budget exceeded" and the work done so far, and leaves any
+ * materialized state invalid, so it can be retried with a larger budget.
+ *
+ * "maxScratchBytes" (default FINBENCH_TCR8_SCRATCH_MB, else unbounded) caps the scratch memory
+ * of the call: the per-vertex and per-edge state as accounted by LoanFlowState::Bytes, the two
+ * frontiers, and the per-vertex sums and rows built from them at the end. A vertex or edge that
+ * would take it past the cap is not added, and the expansion stops. The rows found so far are
+ * then returned with their "truncated" column set, and a materialized state is not kept. The cap
+ * does not cover the serialized response, which grows with the rows, so it is soft by that much.
+ */
 extern "C" bool Process(GraphDB& db, const std::string& request, std::string& response) {
     static const std::string LOAN_LABEL = "Loan";
     static const std::string LOAN_ID = "id";
     static const std::string LOAN_AMOUNT = "loanAmount";
     static const std::string ACCOUNT_ID = "id";
-    static const std::string DEPOSIT_LABEL = "deposit";
-    static const std::string TRANSFER_LABEL = "transfer";
-    static const std::string WITHDRAW_LABEL = "withdraw";
     static const std::string TIMESTAMP = "timestamp";
     static const std::string AMOUNT = "amount";
     json output;
     int64_t id, start_time, end_time;
     int64_t limit = -1;
+    int64_t prefetch = 8;
+    int64_t topk = -1;
+    int64_t max_edges = -1;
+    int64_t max_vertices = -1;
+    int64_t timeout_ms = -1;
+    int64_t max_scratch = LoanFlowScratchLimit();
+    bool materialize = false;
     float threshold;
     try {
         json input = json::parse(request);
+        if (input.contains("warmup")) {
+            return WarmUp(db, input["warmup"].value("top", (int64_t)0), response);
+        }
         parse_from_json(id, "id", input);
         parse_from_json(threshold, "threshold", input);
         parse_from_json(start_time, "startTime", input);
         parse_from_json(end_time, "endTime", input);
         parse_from_json(limit, "limit", input);
+        parse_from_json(prefetch, "prefetch", input);
+        parse_from_json(materialize, "materialize", input);
+        parse_from_json(topk, "topk", input);
+        parse_from_json(max_edges, "maxEdges", input);
+        parse_from_json(max_vertices, "maxVertices", input);
+        parse_from_json(timeout_ms, "timeoutMs", input);
+        parse_from_json(max_scratch, "maxScratchBytes", input);
     } catch (std::exception& e) {
         output["msg"] = "json parse error: " + std::string(e.what());
         response = output.dump();
         return false;
     }
-    auto add_amount = [](std::unordered_map<int64_t, double>& m, int64_t vid, double amount) {
-        auto it = m.find(vid);
-        if (it == m.end() || it->second > amount) {
-            m.emplace(vid, amount);
-        }
-    };
-    auto add_dst =
-        [](std::unordered_map<int64_t, std::unordered_map<std::string, std::pair<double, size_t>>>&
-               merged_in,
-           std::unordered_map<int64_t, double>& m, int64_t dst, int64_t src, const std::string& eid,
-           double amount, float threshold, size_t hop) {
-            if (amount > threshold * m.find(src)->second) {
-                if (merged_in.find(dst) == merged_in.end()) {
-                    merged_in[dst] = {};
-                }
-                if (merged_in[dst].find(eid) == merged_in[dst].end()) {
-                    merged_in[dst][eid] = {amount, hop};
-                }
-            }
-        };
+    WorkBudget budget(max_edges, max_vertices, timeout_ms);
+    if (materialize) EdgeLogEnable();
+    // read before the snapshot is taken, so every insert logged up to here is visible in it
+    int64_t epoch = materialize ? EdgeLogEpoch() : 0;
+    int64_t generation = LoanFlowCacheGeneration();
+    int64_t stamp = EdgeColumnsStamp();
     auto txn = db.CreateReadTxn();
     std::vector<int16_t> deposit_id = {
-        (int16_t)txn.GetEdgeLabelId(DEPOSIT_LABEL),
+        Schema(txn).deposit,
     };
     std::vector<int16_t> edge_label_ids = {
-        (int16_t)txn.GetEdgeLabelId(TRANSFER_LABEL),
-        (int16_t)txn.GetEdgeLabelId(WITHDRAW_LABEL),
+        Schema(txn).transfer,
+        Schema(txn).withdraw,
     };
-    auto loan = txn.GetVertexByUniqueIndex(LOAN_LABEL, LOAN_ID, FieldData(id));
+    auto loan = GetVertexById(txn, IdSpace::kLoan, LOAN_LABEL, LOAN_ID, id);
     auto loan_amount = loan.GetField(LOAN_AMOUNT).AsDouble();
     auto vit = txn.GetVertexIterator();
-    std::unordered_map<int64_t, std::unordered_map<std::string, std::pair<double, size_t>>>
-        merged_in;
-    std::unordered_map<int64_t, double> min_amount;
-    std::unordered_set<int64_t> src_set, dst_set;
+    LoanFlowState local_state;
+    LoanFlowState* state = &local_state;
+    std::shared_ptr<LoanFlowState> cached;
+    std::unique_lock<std::mutex> cached_lock;
+    Frontier src_set, dst_set;
+
+    const uint32_t kNone = std::numeric_limits<uint32_t>::max();
+    bool truncated = false;
+    // ratio, hop, dst
+    typedef std::tuple<double, size_t, int64_t> Row;
+    // replay of logged inserts on a materialized state: (vid, hop) still to expand
+    std::vector<std::pair<int64_t, size_t>> pending;
+    // with `grow`, as it would be after adding one more of everything
+    auto scratch_bytes = [&](bool grow) {
+        auto vector = [grow](size_t size, size_t capacity, size_t item) {
+            return (grow && size == capacity ? std::max<size_t>(2 * capacity, 1) : capacity) * item;
+        };
+        size_t bytes = state->Bytes(grow);
+        bytes += vector(src_set.Size(), src_set.Capacity(), sizeof(int64_t));
+        bytes += vector(dst_set.Size(), dst_set.Capacity(), sizeof(int64_t));
+        // the copy of the sealed frontier that a materialized state keeps
+        if (materialize) bytes += dst_set.Capacity() * sizeof(int64_t);
+        bytes += vector(pending.size(), pending.capacity(), sizeof(pending[0]));
+        // `merged` and `result`, built per vertex at the end
+        bytes += (state->vids.size() + grow) * (sizeof(std::pair<double, size_t>) + sizeof(Row));
+        return bytes;
+    };
+    auto fits = [&]() {
+        if (!truncated && max_scratch >= 0) truncated = scratch_bytes(true) > (size_t)max_scratch;
+        return !truncated;
+    };
+    // local id of vid, recording `amount` as its min_amount if it is new; kNone past the cap
+    auto add_amount = [&](int64_t vid, double amount) {
+        auto it = state->local_ids.find(vid);
+        if (it != state->local_ids.end()) return it->second;
+        if (!fits()) return kNone;
+        uint32_t local = state->vids.size();
+        state->local_ids.emplace(vid, local);
+        state->vids.push_back(vid);
+        state->min_amount.push_back(amount);
+        return local;
+    };
+    // records the edge src -> dst if its amount passes the threshold; the entry, or null
+    auto add_dst = [&](uint32_t dst, uint32_t src, const EdgeUid& uid, double amount,
+                       size_t hop) -> LoanFlowEdge* {
+        if (!(amount > threshold * state->min_amount[src])) return nullptr;
+        LoanFlowEdgeKey key{src, dst, uid.lid, uid.tid, uid.eid};
+        auto it = state->merged_in.find(key);
+        if (it != state->merged_in.end()) return &it->second;
+        if (!fits()) return nullptr;
+        return &state->merged_in.emplace(key, LoanFlowEdge{amount, (uint32_t)hop}).first->second;
+    };
 
-    for (auto deposit =
-             LabeledOutEdgeIterator(loan.GetOutEdgeIterator(), loan.GetId(), 0, deposit_id, limit);
-         deposit.IsValid(); deposit.Next()) {
-        auto ts = deposit.Eit().GetField(TIMESTAMP).AsInt64();
-        auto amount = deposit.Eit().GetField(AMOUNT).AsDouble();
-        if (ts > start_time && ts < end_time) {
-            auto dst = deposit.Eit().GetDst();
-            src_set.emplace(dst);
-            add_amount(min_amount, dst, amount);
+    // f(dst, amount, uid) for the out-edges of vid in the window, as the truncation keeps them
+    AdjacencyColumns columns(stamp);
+    auto for_each_out_edge = [&](int64_t vid, const std::vector<int16_t>& lids, auto&& f) {
+        if (!budget.Vertex()) return;
+        vit.Goto(vid);
+        if (columns.Load(vit, lids, true, limit, false, &budget)) {
+            if (budget.Exhausted()) return;
+            columns.ForEachInWindow(start_time, end_time, -std::numeric_limits<double>::infinity(),
+                                    [&](size_t pos, size_t i) {
+                                        f(columns.Label(pos).other[i], columns.Label(pos).amount[i],
+                                          columns.Uid(pos, i));
+                                    });
+            return;
         }
-    }
-    for (size_t i = 1; i <= 3; i++) {
-        for (auto& vid : src_set) {
-            vit.Goto(vid);
-            for (auto eit = LabeledOutEdgeIterator(vit.GetOutEdgeIterator(), vit.GetId(), 0,
-                                                   edge_label_ids, limit);
-                 eit.IsValid(); eit.Next()) {
-                auto ts = eit.Eit().GetField(TIMESTAMP).AsInt64();
-                auto amount = eit.Eit().GetField(AMOUNT).AsDouble();
-                auto dst_vid = eit.Eit().GetDst();
-                if (ts > start_time && ts < end_time) {
-                    add_amount(min_amount, dst_vid, amount);
-                    add_dst(merged_in, min_amount, dst_vid, vid, eit.Eit().GetUid().ToString(),
-                            amount, threshold, i);
+        for (auto eit = LabeledOutEdgeIterator(vit.GetOutEdgeIterator(), vid, 0, lids, limit,
+                                               TruncationOrder::kTimestampDesc, &budget);
+             eit.IsValid() && budget.Edges(); eit.Next()) {
+            auto ts = eit.Eit().GetField(TIMESTAMP).AsInt64();
+            if (ts > start_time && ts < end_time) {
+                f(eit.Eit().GetDst(), eit.Eit().GetField(AMOUNT).AsDouble(), eit.Eit().GetUid());
+            }
+        }
+    };
 
-                    dst_set.emplace(dst_vid);
+    auto join_frontier = [&](size_t hop, int64_t vid) {
+        auto& f = state->frontiers[hop];
+        auto it = std::lower_bound(f.begin(), f.end(), vid);
+        if (it != f.end() && *it == vid) return false;
+        if (!fits()) return false;
+        f.insert(it, vid);
+        return true;
+    };
+    auto in_frontier = [&](size_t hop, int64_t vid) {
+        auto& f = state->frontiers[hop];
+        return std::binary_search(f.begin(), f.end(), vid);
+    };
+    // set when replay reaches a vertex with another amount than its first one
+    bool diverged = false;
+    auto same_first_amount = [&](int64_t vid, double amount) {
+        auto it = state->local_ids.find(vid);
+        if (it != state->local_ids.end() && state->min_amount[it->second] != amount) {
+            diverged = true;
+        }
+        return !diverged;
+    };
+    auto visit_edge = [&](int64_t src, int64_t dst, const EdgeUid& uid, double amount,
+                          size_t hop) {
+        if (!same_first_amount(dst, amount)) return;
+        uint32_t dst_local = add_amount(dst, amount);
+        if (dst_local == kNone) return;
+        // a full run records an edge at the first hop that reaches it, replay may reach it later
+        auto e = add_dst(dst_local, state->local_ids.at(src), uid, amount, hop);
+        if (e && e->hop > hop) e->hop = hop;
+        if (join_frontier(hop, dst) && hop < 3) pending.emplace_back(dst, hop + 1);
+    };
+    // whether a new edge of vid may have displaced an older one from its truncated adjacency
+    auto exceeds_limit = [&](int64_t vid, const std::vector<int16_t>& lids) {
+        if (limit < 0) return false;
+        int64_t n = 0;
+        vit.Goto(vid);
+        for (auto eit = LabeledOutEdgeIterator(vit.GetOutEdgeIterator(), vid, 0, lids, limit + 1);
+             eit.IsValid() && n <= limit; eit.Next()) {
+            n++;
+        }
+        return n > limit;
+    };
+    auto drain_pending = [&]() {
+        while (!pending.empty() && !budget.Exhausted() && !truncated && !diverged) {
+            auto vid = pending.back().first;
+            auto hop = pending.back().second;
+            pending.pop_back();
+            for_each_out_edge(vid, edge_label_ids, [&](int64_t dst, double amount, EdgeUid uid) {
+                visit_edge(vid, dst, uid, amount, hop);
+            });
+        }
+    };
+    auto apply_deltas = [&](const std::vector<EdgeDelta>& deltas) {
+        for (auto& d : deltas) {
+            if (budget.Exhausted() || truncated || diverged) return false;
+            // edges outside the window still count towards the truncation, so check the limit first
+            bool in_window = d.ts > start_time && d.ts < end_time;
+            if (d.lid == deposit_id[0]) {
+                if (d.src != loan.GetId()) continue;
+                if (exceeds_limit(d.src, deposit_id)) return false;
+                if (!in_window) continue;
+                if (!same_first_amount(d.dst, d.amount)) return false;
+                if (add_amount(d.dst, d.amount) == kNone) return false;
+                if (join_frontier(0, d.dst)) pending.emplace_back(d.dst, 1);
+            } else if (d.lid == edge_label_ids[0] || d.lid == edge_label_ids[1]) {
+                if (!in_frontier(0, d.src) && !in_frontier(1, d.src) && !in_frontier(2, d.src)) {
+                    continue;
+                }
+                if (exceeds_limit(d.src, edge_label_ids)) return false;
+                if (!in_window) continue;
+                EdgeUid uid(d.src, d.dst, d.lid, d.tid, d.eid);
+                for (size_t i = 1; i <= 3; i++) {
+                    if (in_frontier(i - 1, d.src)) visit_edge(d.src, d.dst, uid, d.amount, i);
                 }
             }
+            drain_pending();
+        }
+        return !diverged && !budget.Exhausted() && !truncated;
+    };
+
+    bool up_to_date = false;
+    if (materialize) {
+        cached = LoanFlowCacheGet({loan.GetId(), start_time, end_time, threshold, limit});
+        cached_lock = std::unique_lock<std::mutex>(cached->mutex);
+        state = cached.get();
+        if (state->valid) {
+            std::vector<EdgeDelta> deltas;
+            up_to_date = state->epoch >= epoch ||
+                         (EdgeLogRange(state->epoch, epoch, deltas) && apply_deltas(deltas));
         }
-        std::swap(src_set, dst_set);
-        dst_set.clear();
+        state->valid = false;
     }
-    // ratio, hop, dst
-    std::vector<std::tuple<double, size_t, int64_t>> result;
-    for (auto& kv1 : merged_in) {
-        double sum = 0;
-        size_t hop = std::numeric_limits<size_t>::max();
-        vit.Goto(kv1.first);
-        for (auto& kv2 : kv1.second) {
-            sum += kv2.second.first;
-            hop = std::min(kv2.second.second + 1, hop);
+    if (!up_to_date) {
+        // a replay that hit the cap starts over with the whole budget
+        state->Clear();
+        truncated = false;
+        for_each_out_edge(loan.GetId(), deposit_id, [&](int64_t dst, double amount, EdgeUid) {
+            if (add_amount(dst, amount) != kNone && fits()) src_set.Add(dst);
+        });
+        src_set.Seal();
+        if (materialize) state->frontiers[0] = src_set.Vids();
+        for (size_t i = 1; i <= 3 && !budget.Exhausted() && !truncated; i++) {
+            AdjacencyPrefetcher prefetcher(db, src_set.Vids(), edge_label_ids, prefetch);
+            for (size_t k = 0; k < src_set.Size() && !budget.Exhausted() && !truncated; k++) {
+                auto vid = src_set[k];
+                uint32_t src_local = state->local_ids.at(vid);
+                prefetcher.Advance(k);
+                for_each_out_edge(vid, edge_label_ids,
+                                  [&](int64_t dst_vid, double amount, EdgeUid uid) {
+                                      uint32_t dst_local = add_amount(dst_vid, amount);
+                                      if (dst_local == kNone) return;
+                                      add_dst(dst_local, src_local, uid, amount, i);
+                                      if (fits()) dst_set.Add(dst_vid);
+                                  });
+            }
+            dst_set.Seal();
+            if (materialize) state->frontiers[i] = dst_set.Vids();
+            src_set.Swap(dst_set);
+            dst_set.Clear();
         }
-        result.emplace_back(std::round(1000.0 * sum / loan_amount) / 1000, hop,
-                            vit.GetField(ACCOUNT_ID).AsInt64());
     }
-    std::sort(result.begin(), result.end(),
-              [=](std::tuple<double, size_t, int64_t>& l, std::tuple<double, size_t, int64_t>& r) {
-                  return std::get<1>(l) == std::get<1>(r)
-                             ? (std::get<0>(l) == std::get<0>(r) ? std::get<2>(l) < std::get<2>(r)
-                                                                 : std::get<0>(l) > std::get<0>(r))
-                             : std::get<1>(l) > std::get<1>(r);
-              });
-    lgraph_api::Result api_result(
-        {{"i", LGraphType::INTEGER}, {"r", LGraphType::DOUBLE}, {"d", LGraphType::INTEGER}});
+    if (budget.Exhausted()) {
+        output["msg"] = "budget exceeded";
+        output["edges"] = budget.ScannedEdges();
+        output["vertices"] = budget.VisitedVertices();
+        output["elapsedMs"] = budget.ElapsedMs();
+        response = output.dump();
+        return false;
+    }
+    if (materialize) {
+        // a delete in flight or committed after the snapshot may have cleared the cache since
+        state->valid =
+            !truncated && generation % 2 == 0 && LoanFlowCacheGeneration() == generation;
+        state->epoch = up_to_date ? std::max(state->epoch, epoch) : epoch;
+    }
+    auto before = [](const Row& l, const Row& r) {
+        return std::get<1>(l) == std::get<1>(r)
+                   ? (std::get<0>(l) == std::get<0>(r) ? std::get<2>(l) < std::get<2>(r)
+                                                       : std::get<0>(l) > std::get<0>(r))
+                   : std::get<1>(l) > std::get<1>(r);
+    };
+    // a max-heap under `before`, so the front is the row to drop first
+    size_t keep = topk < 0 ? std::numeric_limits<size_t>::max() : topk;
+    // amount sum and distance per local id; the distance stays max for vertices without edges
+    std::vector<std::pair<double, size_t>> merged(state->vids.size(),
+                                                  {0.0, std::numeric_limits<size_t>::max()});
+    for (auto& kv : state->merged_in) {
+        auto& m = merged[kv.first.dst];
+        m.first += kv.second.amount;
+        m.second = std::min<size_t>(kv.second.hop + 1, m.second);
+    }
+    std::vector<Row> result;
+    result.reserve(std::min(keep, merged.size()));
+    for (uint32_t local = 0; local < merged.size(); local++) {
+        double sum = merged[local].first;
+        size_t hop = merged[local].second;
+        if (hop == std::numeric_limits<size_t>::max()) continue;
+        double ratio = std::round(1000.0 * sum / loan_amount) / 1000;
+        if (result.size() == keep &&
+            (keep == 0 ||
+             !before(Row(ratio, hop, std::numeric_limits<int64_t>::min()), result.front()))) {
+            continue;
+        }
+        vit.Goto(state->vids[local]);
+        Row row(ratio, hop, vit.GetField(ACCOUNT_ID).AsInt64());
+        if (result.size() < keep) {
+            result.push_back(row);
+            if (topk >= 0) std::push_heap(result.begin(), result.end(), before);
+        } else if (before(row, result.front())) {
+            std::pop_heap(result.begin(), result.end(), before);
+            result.back() = row;
+            std::push_heap(result.begin(), result.end(), before);
+        }
+    }
+    if (topk >= 0) {
+        std::sort_heap(result.begin(), result.end(), before);
+    } else {
+        std::sort(result.begin(), result.end(), before);
+    }
+    lgraph_api::Result api_result({{"i", LGraphType::INTEGER},
+                                   {"r", LGraphType::DOUBLE},
+                                   {"d", LGraphType::INTEGER},
+                                   {"truncated", LGraphType::BOOLEAN}});
     for (auto& item : result) {
         auto& r = api_result.NewRecord();
         r.Insert("i", FieldData::Int64(std::get<2>(item)));
         r.Insert("r", FieldData::Double(std::get<0>(item)));
         r.Insert("d", FieldData::Int64(std::get<1>(item)));
+        r.Insert("truncated", FieldData::Bool(truncated));
     }
     response = api_result.Dump();
     return true;
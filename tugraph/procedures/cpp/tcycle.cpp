@@ -0,0 +1,99 @@
+/**
+ * Copyright 2022 AntGroup CO., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ */
+
+#include <exception>
+#include <iostream>
+#include "lgraph/lgraph.h"
+#include "lgraph/lgraph_types.h"
+#include "lgraph/lgraph_utils.h"
+#include "lgraph/lgraph_result.h"
+#include "tools/json.hpp"
+#include "finbench_plugin.h"
+#include "finbench_runtime.h"
+
+using namespace lgraph_api;
+using json = nlohmann::json;
+
+/*
+ * Whether a transfer srcId -> dstId would close a transfer cycle of k edges (3..6) within the
+ * window, the read-only counterpart of the check in trw1 for longer laundering loops. With
+ * "ascending": true the timestamps along dstId -> ... -> srcId must strictly increase.
+ */
+extern "C" bool Process(GraphDB& db, const std::string& request, std::string& response) {
+    static const std::string ACCOUNT_LABEL = "Account";
+    static const std::string ACCOUNT_ID = "id";
+    json output;
+    int64_t src_id, dst_id, start_time, end_time;
+    int64_t k = 4;
+    int64_t limit = -1;
+    bool ascending = false;
+    try {
+        json input = json::parse(request);
+        if (input.contains("warmup")) {
+            return WarmUp(db, input["warmup"].value("top", (int64_t)0), response);
+        }
+        parse_from_json(src_id, "srcId", input);
+        parse_from_json(dst_id, "dstId", input);
+        parse_from_json(k, "k", input);
+        parse_from_json(start_time, "startTime", input);
+        parse_from_json(end_time, "endTime", input);
+        parse_from_json(limit, "limit", input);
+        parse_from_json(ascending, "ascending", input);
+    } catch (std::exception& e) {
+        output["msg"] = "json parse error: " + std::string(e.what());
+        response = output.dump();
+        return false;
+    }
+    if (k < 3 || k > 6) {
+        output["msg"] = "k must be within 3..6";
+        response = output.dump();
+        return false;
+    }
+    int64_t stamp = EdgeColumnsStamp();
+    auto txn = db.CreateReadTxn();
+    auto src = GetVertexById(txn, IdSpace::kAccount, ACCOUNT_LABEL, ACCOUNT_ID, src_id);
+    auto dst = GetVertexById(txn, IdSpace::kAccount, ACCOUNT_LABEL, ACCOUNT_ID, dst_id);
+    bool found = false;
+    if (src.IsValid() && dst.IsValid()) {
+        std::vector<int16_t> transfer_id = {
+            Schema(txn).transfer,
+        };
+        WindowedExpander expand(txn, transfer_id, start_time, end_time, limit, stamp);
+        size_t src_in = expand.Degree(src.GetId(), false);
+        size_t dst_out = expand.Degree(dst.GetId(), true);
+        switch (k) {
+            case 3:
+                found = FindCycle<3>(src.GetId(), dst.GetId(), ascending, expand,
+                                     PlanCycleReversed<3>(src_in, dst_out));
+                break;
+            case 4:
+                found = FindCycle<4>(src.GetId(), dst.GetId(), ascending, expand,
+                                     PlanCycleReversed<4>(src_in, dst_out));
+                break;
+            case 5:
+                found = FindCycle<5>(src.GetId(), dst.GetId(), ascending, expand,
+                                     PlanCycleReversed<5>(src_in, dst_out));
+                break;
+            default:
+                found = FindCycle<6>(src.GetId(), dst.GetId(), ascending, expand,
+                                     PlanCycleReversed<6>(src_in, dst_out));
+                break;
+        }
+    }
+    lgraph_api::Result api_result({{"found", LGraphType::BOOLEAN}});
+    auto& r = api_result.NewRecord();
+    r.Insert("found", FieldData::Bool(found));
+    response = api_result.Dump();
+    return true;
+}
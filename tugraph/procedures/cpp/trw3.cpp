@@ -20,73 +20,17 @@
 #include "lgraph/lgraph_utils.h"
 #include "lgraph/lgraph_result.h"
 #include "tools/json.hpp"
+#include "finbench_plugin.h"
+#include "finbench_runtime.h"
 
 using namespace lgraph_api;
 using json = nlohmann::json;
 
-template <typename EIT>
-class LabeledEdgeIterator {
- public:
-    LabeledEdgeIterator(EIT&& eit, const int64_t src, const int64_t dst,
-                        const std::vector<int16_t>& lids, int64_t per_node_limit)
-        : eit_(std::move(eit)) {
-        if (lids.empty()) {
-            valid_ = false;
-            return;
-        }
-        valid_ = true;
-        lid_pos_ = 0;
-        lids_ = lids;
-        src_ = src;
-        dst_ = dst;
-        per_node_limit_ = per_node_limit;
-        count_ = 1;
-        eit_.Goto(EdgeUid(src_, dst_, lids_[lid_pos_], 0, 0), true);
-        while (!_IsCurLabelValid() && _NextLabel()) {
-        }
-    }
-
-    bool IsValid() { return valid_; }
-
-    void Next() {
-        count_ += 1;
-        eit_.Next();
-        while (!_IsCurLabelValid() && _NextLabel()) {
-        }
-    }
-
-    EdgeUid GetUid() { return eit_.GetUid(); }
-
-    EIT& Eit() { return eit_; }
-
- private:
-    bool _IsCurLabelValid() {
-        return lid_pos_ < lids_.size() && eit_.IsValid() && eit_.GetLabelId() == lids_[lid_pos_] &&
-               (per_node_limit_ < 0 || count_ <= per_node_limit_);
-    }
-
-    bool _NextLabel() {
-        count_ = 1;
-        if (++lid_pos_ >= lids_.size()) {
-            valid_ = false;
-            return valid_;
-        }
-        eit_.Goto(EdgeUid(src_, dst_, lids_[lid_pos_], 0, 0), true);
-        return true;
-    }
-
-    EIT eit_;
-    bool valid_;
-    int64_t src_, dst_;
-    int64_t per_node_limit_;
-    size_t count_;
-    size_t lid_pos_;
-    std::vector<int16_t> lids_;
-};
-
-typedef LabeledEdgeIterator<OutEdgeIterator> LabeledOutEdgeIterator;
-typedef LabeledEdgeIterator<InEdgeIterator> LabeledInEdgeIterator;
-
+/*
+ * "maxEdges", "maxVertices" and "timeoutMs" bound the guarantee expansion (see WorkBudget). A call
+ * that runs out aborts without adding the guarantee and returns false with msg "budget exceeded"
+ * and the work done so far, so the driver can retry it with a larger budget.
+ */
 extern "C" bool Process(GraphDB& db, const std::string& request, std::string& response) {
     static const std::string PERSON_LABEL = "Person";
     static const std::string PERSON_ID = "id";
@@ -95,14 +39,19 @@ extern "C" bool Process(GraphDB& db, const std::string& request, std::string& re
     static const std::string GUARANTEE_TIMESTAMP = "timestamp";
     static const std::string LOAN_LOANAMOUNT = "loanAmount";
     static const std::vector<std::string> GUARANTEE_FIELD_NAMES = {"timestamp"};
-    static const std::string APPLY_LABEL = "apply";
     lgraph_api::Result api_result({{"msg", LGraphType::STRING}, {"txn", LGraphType::STRING}});
     auto& record = api_result.NewRecord();
     record.Insert("txn", FieldData::String("abort"));
     int64_t src_id, dst_id, time, threshold, start_time, end_time;
     int64_t limit = -1;
+    int64_t max_edges = -1;
+    int64_t max_vertices = -1;
+    int64_t timeout_ms = -1;
     try {
         json input = json::parse(request);
+        if (input.contains("warmup")) {
+            return WarmUp(db, input["warmup"].value("top", (int64_t)0), response);
+        }
         parse_from_json(src_id, "srcId", input);
         parse_from_json(dst_id, "dstId", input);
         parse_from_json(time, "time", input);
@@ -110,19 +59,24 @@ extern "C" bool Process(GraphDB& db, const std::string& request, std::string& re
         parse_from_json(start_time, "startTime", input);
         parse_from_json(end_time, "endTime", input);
         parse_from_json(limit, "limit", input);
+        parse_from_json(max_edges, "maxEdges", input);
+        parse_from_json(max_vertices, "maxVertices", input);
+        parse_from_json(timeout_ms, "timeoutMs", input);
     } catch (std::exception& e) {
         record.Insert("msg", FieldData::String("json parse error: " + std::string(e.what())));
         response = api_result.Dump();
         return false;
     }
+    WorkBudget budget(max_edges, max_vertices, timeout_ms);
+    BlockedLoad(db);
     auto txn = db.CreateWriteTxn();
-    auto src = txn.GetVertexByUniqueIndex(PERSON_LABEL, PERSON_ID, FieldData(src_id));
-    auto dst = txn.GetVertexByUniqueIndex(PERSON_LABEL, PERSON_ID, FieldData(dst_id));
+    auto src = GetVertexById(txn, IdSpace::kPerson, PERSON_LABEL, PERSON_ID, src_id);
+    auto dst = GetVertexById(txn, IdSpace::kPerson, PERSON_LABEL, PERSON_ID, dst_id);
     std::vector<int16_t> guarantee_id = {
-        (int16_t)txn.GetEdgeLabelId(GUARANTEE_LABEL),
+        Schema(txn).guarantee,
     };
     std::vector<int16_t> apply_id = {
-        (int16_t)txn.GetEdgeLabelId(APPLY_LABEL),
+        Schema(txn).apply,
     };
 
     if (!src.IsValid() || !dst.IsValid()) {
@@ -131,7 +85,7 @@ extern "C" bool Process(GraphDB& db, const std::string& request, std::string& re
         txn.Abort();
         return false;
     }
-    if (src.GetField(PERSON_ISBLOCKED).AsBool() || dst.GetField(PERSON_ISBLOCKED).AsBool()) {
+    if (IsBlocked(src) || IsBlocked(dst)) {
         record.Insert("msg", FieldData::String("src/dst is blocked"));
         response = api_result.Dump();
         txn.Abort();
@@ -141,35 +95,48 @@ extern "C" bool Process(GraphDB& db, const std::string& request, std::string& re
                 std::vector<FieldData>{FieldData(time)});
 
     // expand src
-    std::unordered_set<int64_t> visited, dst_set, src_set{src.GetId()}, loans;
-    while (!src_set.empty()) {
-        for (auto& vid : src_set) {
-            src.Goto(vid);
+    std::unordered_set<int64_t> visited;
+    Frontier src_set, dst_set, guarantors, loans;
+    src_set.Add(src.GetId());
+    while (!src_set.Empty() && !budget.Exhausted()) {
+        for (size_t k = 0; k < src_set.Size() && budget.Vertex(); k++) {
+            src.Goto(src_set[k]);
             for (auto eit = LabeledOutEdgeIterator(src.GetOutEdgeIterator(), src.GetId(), 0,
-                                                   guarantee_id, limit);
-                 eit.IsValid(); eit.Next()) {
+                                                   guarantee_id, limit,
+                                                   TruncationOrder::kTimestampDesc, &budget);
+                 eit.IsValid() && budget.Edges(); eit.Next()) {
                 auto ts = eit.Eit().GetField(GUARANTEE_TIMESTAMP).AsInt64();
                 if (ts > start_time && ts < end_time &&
                     visited.find(eit.Eit().GetDst()) == visited.end()) {
-                    dst_set.emplace(eit.Eit().GetDst());
+                    dst_set.Add(eit.Eit().GetDst());
                     visited.emplace(eit.Eit().GetDst());
                 }
             }
         }
-        swap(src_set, dst_set);
-        dst_set.clear();
+        dst_set.Seal();
+        src_set.Swap(dst_set);
+        dst_set.Clear();
     }
-    int64_t sum_loan;
-    for (auto& vid : visited) {
-        src.Goto(vid);
+    for (auto vid : visited) guarantors.Add(vid);
+    guarantors.Seal();
+    for (size_t k = 0; k < guarantors.Size() && budget.Vertex(); k++) {
+        src.Goto(guarantors[k]);
         for (auto eit =
-                 LabeledOutEdgeIterator(src.GetOutEdgeIterator(), src.GetId(), 0, apply_id, limit);
-             eit.IsValid(); eit.Next()) {
-            loans.emplace(eit.Eit().GetDst());
+                 LabeledOutEdgeIterator(src.GetOutEdgeIterator(), src.GetId(), 0, apply_id, limit,
+                                        TruncationOrder::kTimestampDesc, &budget);
+             eit.IsValid() && budget.Edges(); eit.Next()) {
+            loans.Add(eit.Eit().GetDst());
         }
     }
+    loans.Seal();
+    if (budget.Exhausted()) {
+        txn.Abort();
+        record.Insert("msg", FieldData::String("budget exceeded: " + budget.Summary()));
+        response = api_result.Dump();
+        return false;
+    }
     double loan_sum = 0;
-    for (auto& loan : loans) {
+    for (auto loan : loans.Vids()) {
         src.Goto(loan);
         loan_sum += src.GetField(LOAN_LOANAMOUNT).AsDouble();
         if (loan_sum > threshold) {
@@ -185,8 +152,8 @@ extern "C" bool Process(GraphDB& db, const std::string& request, std::string& re
         return true;
     }
     txn = db.CreateWriteTxn();
-    src = txn.GetVertexByUniqueIndex(PERSON_LABEL, PERSON_ID, FieldData(src_id));
-    dst = txn.GetVertexByUniqueIndex(PERSON_LABEL, PERSON_ID, FieldData(dst_id));
+    src = GetVertexById(txn, IdSpace::kPerson, PERSON_LABEL, PERSON_ID, src_id);
+    dst = GetVertexById(txn, IdSpace::kPerson, PERSON_LABEL, PERSON_ID, dst_id);
     if (!src.IsValid() || !dst.IsValid()) {
         txn.Abort();
         record.Insert("msg", FieldData::String("src/dst invalid"));
@@ -198,7 +165,7 @@ extern "C" bool Process(GraphDB& db, const std::string& request, std::string& re
     record.Insert("msg", FieldData::String("block src/dst"));
     record.Insert("txn", FieldData::String("commit"));
     response = api_result.Dump();
-    txn.Commit();
+    CommitBlocked(txn, {src.GetId(), dst.GetId()});
     return true;
 }
 
@@ -0,0 +1,29 @@
+/**
+ * Copyright 2022 AntGroup CO., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ */
+
+#include <string>
+#include "lgraph/lgraph.h"
+#include "finbench_plugin.h"
+#include "finbench_runtime.h"
+
+using namespace lgraph_api;
+
+// Write 12: add a transfer between two accounts. Runs as a plugin so that the insert keeps the edge
+// column cache, the degree statistics and the edge log of materialized tcr8 results coherent.
+extern "C" bool Process(GraphDB& db, const std::string& request, std::string& response) {
+    static const std::string SRC_LABEL = "Account";
+    static const std::string EDGE_LABEL = "transfer";
+    return AddAmountEdge(db, request, response, IdSpace::kAccount, SRC_LABEL, "srcId", "dstId",
+                         EDGE_LABEL);
+}
@@ -0,0 +1,114 @@
+/**
+ * Copyright 2022 AntGroup CO., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ */
+
+#include <exception>
+#include <iostream>
+#include <unordered_set>
+#include "lgraph/lgraph.h"
+#include "lgraph/lgraph_types.h"
+#include "lgraph/lgraph_utils.h"
+#include "lgraph/lgraph_result.h"
+#include "tools/json.hpp"
+#include "finbench_plugin.h"
+#include "finbench_runtime.h"
+
+using namespace lgraph_api;
+using json = nlohmann::json;
+
+// Write 17: delete an account together with the loans it repays or is deposited from. Runs as a
+// plugin so the id cache entries of the deleted vertices and the cached results that may refer to
+// them are dropped eagerly.
+extern "C" bool Process(GraphDB& db, const std::string& request, std::string& response) {
+    static const std::string ACCOUNT_LABEL = "Account";
+    static const std::string ACCOUNT_ID = "id";
+    static const std::string LOAN_ID = "id";
+    lgraph_api::Result api_result({{"msg", LGraphType::STRING}, {"txn", LGraphType::STRING}});
+    auto& record = api_result.NewRecord();
+    record.Insert("txn", FieldData::String("abort"));
+    int64_t id;
+    try {
+        json input = json::parse(request);
+        if (input.contains("warmup")) {
+            return WarmUp(db, input["warmup"].value("top", (int64_t)0), response);
+        }
+        parse_from_json(id, "id", input);
+    } catch (std::exception& e) {
+        record.Insert("msg", FieldData::String("json parse error: " + std::string(e.what())));
+        response = api_result.Dump();
+        return false;
+    }
+    auto txn = db.CreateWriteTxn();
+    auto acc = GetVertexById(txn, IdSpace::kAccount, ACCOUNT_LABEL, ACCOUNT_ID, id);
+    if (!acc.IsValid()) {
+        record.Insert("msg", FieldData::String("account not found"));
+        record.Insert("txn", FieldData::String("commit"));
+        response = api_result.Dump();
+        txn.Commit();
+        return true;
+    }
+    const SchemaIds& schema = Schema(txn);
+    auto repay_id = (uint16_t)schema.repay;
+    auto deposit_id = (uint16_t)schema.deposit;
+    std::unordered_set<int64_t> loans;
+    for (auto eit = acc.GetOutEdgeIterator(EdgeUid(acc.GetId(), 0, repay_id, 0, 0), true);
+         eit.IsValid() && eit.GetSrc() == acc.GetId() && eit.GetLabelId() == repay_id;
+         eit.Next()) {
+        loans.emplace(eit.GetDst());
+    }
+    for (auto eit = acc.GetInEdgeIterator(EdgeUid(0, acc.GetId(), deposit_id, 0, 0), true);
+         eit.IsValid() && eit.GetDst() == acc.GetId() && eit.GetLabelId() == deposit_id;
+         eit.Next()) {
+        loans.emplace(eit.GetSrc());
+    }
+    // the deleted vertices and every vertex losing a cached or counted edge with them
+    std::vector<int16_t> lids = {schema.transfer, schema.withdraw, schema.deposit, schema.repay};
+    std::unordered_set<int64_t> touched = loans;
+    int64_t acc_vid = acc.GetId();
+    touched.emplace(acc_vid);
+    auto vit = txn.GetVertexIterator();
+    for (auto vid : std::vector<int64_t>(touched.begin(), touched.end())) {
+        if (!vit.Goto(vid)) continue;
+        for (auto lid : lids) {
+            for (auto eit = vit.GetOutEdgeIterator(EdgeUid(vid, 0, lid, 0, 0), true);
+                 eit.IsValid() && eit.GetSrc() == vid && eit.GetLabelId() == lid; eit.Next()) {
+                touched.emplace(eit.GetDst());
+            }
+            for (auto eit = vit.GetInEdgeIterator(EdgeUid(0, vid, lid, 0, 0), true);
+                 eit.IsValid() && eit.GetDst() == vid && eit.GetLabelId() == lid; eit.Next()) {
+                touched.emplace(eit.GetSrc());
+            }
+        }
+    }
+    // delete through a single iterator, other iterators may be invalidated by the writes
+    for (auto vid : loans) {
+        if (!vit.Goto(vid)) continue;
+        IdCacheErase(IdSpace::kLoan, vit.GetField(LOAN_ID).AsInt64());
+        vit.Delete();
+    }
+    IdCacheErase(IdSpace::kAccount, id);
+    if (vit.Goto(acc_vid)) vit.Delete();
+    record.Insert("msg", FieldData::String("deleted"));
+    record.Insert("txn", FieldData::String("commit"));
+    response = api_result.Dump();
+    {
+        EdgeColumnsWriteGuard guard(std::vector<int64_t>(touched.begin(), touched.end()));
+        // no state computed from here until the clear after the commit is kept
+        LoanFlowCacheClear();
+        txn.Commit();
+    }
+    LoanFlowCacheClear();
+    for (auto vid : touched) DegreeStatsForget(vid, lids);
+    BlockedForget(acc_vid);
+    return true;
+}
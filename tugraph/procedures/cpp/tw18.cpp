@@ -0,0 +1,63 @@
+/**
+ * Copyright 2022 AntGroup CO., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ */
+
+#include <exception>
+#include <iostream>
+#include "lgraph/lgraph.h"
+#include "lgraph/lgraph_types.h"
+#include "lgraph/lgraph_utils.h"
+#include "lgraph/lgraph_result.h"
+#include "tools/json.hpp"
+#include "finbench_plugin.h"
+#include "finbench_runtime.h"
+
+using namespace lgraph_api;
+using json = nlohmann::json;
+
+// Write 18: block an account. Runs as a plugin so the blocked bitmap is updated with the write.
+extern "C" bool Process(GraphDB& db, const std::string& request, std::string& response) {
+    static const std::string ACCOUNT_LABEL = "Account";
+    static const std::string ACCOUNT_ID = "id";
+    static const std::string ACCOUNT_ISBLOCKED = "isBlocked";
+    lgraph_api::Result api_result({{"msg", LGraphType::STRING}, {"txn", LGraphType::STRING}});
+    auto& record = api_result.NewRecord();
+    record.Insert("txn", FieldData::String("abort"));
+    int64_t id;
+    try {
+        json input = json::parse(request);
+        if (input.contains("warmup")) {
+            return WarmUp(db, input["warmup"].value("top", (int64_t)0), response);
+        }
+        parse_from_json(id, "id", input);
+    } catch (std::exception& e) {
+        record.Insert("msg", FieldData::String("json parse error: " + std::string(e.what())));
+        response = api_result.Dump();
+        return false;
+    }
+    auto txn = db.CreateWriteTxn();
+    auto acc = GetVertexById(txn, IdSpace::kAccount, ACCOUNT_LABEL, ACCOUNT_ID, id);
+    if (!acc.IsValid()) {
+        record.Insert("msg", FieldData::String("account not found"));
+        record.Insert("txn", FieldData::String("commit"));
+        response = api_result.Dump();
+        txn.Commit();
+        return true;
+    }
+    acc.SetField(ACCOUNT_ISBLOCKED, FieldData(true));
+    record.Insert("msg", FieldData::String("blocked"));
+    record.Insert("txn", FieldData::String("commit"));
+    response = api_result.Dump();
+    CommitBlocked(txn, {acc.GetId()});
+    return true;
+}
@@ -0,0 +1,336 @@
+/**
+ * Copyright 2022 AntGroup CO., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ */
+
+/*
+ * Rewrites a converted snapshot with every edge file of import.conf in storage order: by source
+ * vid, then timestamp in the tid_order of the label (rows without a numeric timestamp sort as
+ * timestamp 0), then destination vid. Vids are interned in the order the vertex files of
+ * import.conf are listed and read, so that lgraph_import receives its edges already in key order.
+ * Vertex files are copied as they are.
+ *
+ * Each file is mapped and split into ranges of whole lines that are parsed and sorted in
+ * parallel. A row is kept as a fixed-width record (src vid, timestamp, dst vid, offset) that
+ * points into the mapping. Only the records are sorted and merged, and the rows are then copied
+ * once, in their final order.
+ *
+ * usage: ./presort_snapshot import.conf snapshot_dir out_dir [threads]
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include "tools/json.hpp"
+
+using json = nlohmann::json;
+
+static void Fail(const std::string& msg) {
+    std::fprintf(stderr, "%s\n", msg.c_str());
+    std::exit(1);
+}
+
+// A read-only mapping of a whole file.
+class MappedFile {
+ public:
+    explicit MappedFile(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) Fail("cannot open " + path);
+        struct stat st;
+        if (fstat(fd, &st) != 0) Fail("cannot stat " + path);
+        size_ = st.st_size;
+        if (size_ > 0) {
+            void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) Fail("cannot map " + path);
+            madvise(data, size_, MADV_SEQUENTIAL);
+            data_ = static_cast<const char*>(data);
+        }
+        close(fd);
+    }
+
+    ~MappedFile() {
+        if (size_ > 0) munmap(const_cast<char*>(data_), size_);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::string_view Text() const { return std::string_view(data_, size_); }
+
+ private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Offset of the line after the first `lines` lines of text.
+static size_t SkipLines(std::string_view text, int64_t lines) {
+    size_t pos = 0;
+    for (int64_t i = 0; i < lines && pos < text.size(); i++) {
+        pos = text.find('\n', pos);
+        pos = pos == std::string_view::npos ? text.size() : pos + 1;
+    }
+    return pos;
+}
+
+// Cuts text[begin, end) into n ranges of whole lines, as n + 1 bounds.
+static std::vector<size_t> SplitLines(std::string_view text, size_t begin, size_t n) {
+    std::vector<size_t> bounds = {begin};
+    for (size_t i = 1; i < n; i++) {
+        size_t pos = std::max(bounds.back(), begin + (text.size() - begin) * i / n);
+        if (pos > begin && pos < text.size() && text[pos - 1] != '\n') {
+            pos = text.find('\n', pos);
+            pos = pos == std::string_view::npos ? text.size() : pos + 1;
+        }
+        bounds.push_back(std::min(pos, text.size()));
+    }
+    bounds.push_back(text.size());
+    return bounds;
+}
+
+// f(i) for i in [0, n), one thread each
+template <typename F>
+static void ParallelFor(size_t n, F&& f) {
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < n; i++) threads.emplace_back([&f, i]() { f(i); });
+    if (n > 0) f(0);
+    for (auto& t : threads) t.join();
+}
+
+/*
+ * f(line, offset) for every line of text[begin, end), with the fields at `wanted` (ascending
+ * column indexes) split out into `fields`. Empty lines are skipped.
+ */
+template <typename F>
+static void ForEachRow(std::string_view text, size_t begin, size_t end,
+                       const std::vector<size_t>& wanted, std::vector<std::string_view>& fields,
+                       F&& f) {
+    fields.resize(wanted.size());
+    while (begin < end) {
+        size_t eol = text.find('\n', begin);
+        if (eol == std::string_view::npos || eol > end) eol = end;
+        std::string_view line = text.substr(begin, eol - begin);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if (!line.empty()) {
+            size_t column = 0, start = 0, w = 0;
+            while (w < wanted.size()) {
+                size_t sep = line.find('|', start);
+                if (sep == std::string_view::npos) sep = line.size();
+                if (column == wanted[w]) fields[w++] = line.substr(start, sep - start);
+                if (sep == line.size()) break;
+                column++;
+                start = sep + 1;
+            }
+            for (; w < wanted.size(); w++) fields[w] = std::string_view();
+            f(line, begin);
+        }
+        begin = eol + 1;
+    }
+}
+
+static bool ParseInt(std::string_view s, int64_t& v) {
+    auto r = std::from_chars(s.data(), s.data() + s.size(), v);
+    return r.ec == std::errc() && r.ptr == s.data() + s.size();
+}
+
+static size_t ColumnIndex(const json& file, const std::string& column) {
+    auto& columns = file["columns"];
+    for (size_t i = 0; i < columns.size(); i++) {
+        if (columns[i].get<std::string>() == column) return i;
+    }
+    return std::numeric_limits<size_t>::max();
+}
+
+struct EdgeRecord {
+    int64_t src;
+    // the timestamp, negated for labels stored newest first
+    int64_t ts;
+    int64_t dst;
+    uint64_t offset;
+    uint32_t length;
+
+    bool operator<(const EdgeRecord& r) const {
+        return std::tie(src, ts, dst, offset) < std::tie(r.src, r.ts, r.dst, r.offset);
+    }
+};
+
+typedef std::unordered_map<int64_t, int64_t> VidMap;
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        std::fprintf(stderr, "usage: %s import.conf snapshot_dir out_dir [threads]\n", argv[0]);
+        return 1;
+    }
+    std::string in_dir = argv[2], out_dir = argv[3];
+    size_t threads = argc > 4 ? std::strtoull(argv[4], nullptr, 10)
+                              : std::max(1u, std::thread::hardware_concurrency());
+    threads = std::max<size_t>(threads, 1);
+    json conf;
+    {
+        std::ifstream in(argv[1]);
+        if (!in) Fail(std::string("cannot open ") + argv[1]);
+        conf = json::parse(in);
+    }
+    std::unordered_map<std::string, json> schema;
+    for (auto& s : conf["schema"]) schema[s["label"].get<std::string>()] = s;
+    std::filesystem::create_directories(out_dir);
+    auto begin = std::chrono::steady_clock::now();
+
+    /*
+     * Vertex files in listed order, each one's ids in row order, numbered from 0 across all
+     * labels. This assumes lgraph_import assigns vids the same way: one after another in the
+     * order import.conf lists the vertex files, skipping repeated ids. If it numbers them any
+     * other way the output is still a valid snapshot, only no longer in the importer's key order.
+     */
+    std::unordered_map<std::string, VidMap> vids;
+    int64_t next_vid = 0;
+    for (auto& file : conf["files"]) {
+        auto label = file["label"].get<std::string>();
+        auto& s = schema.at(label);
+        if (s["type"] != "VERTEX") continue;
+        auto path = file["path"].get<std::string>();
+        size_t primary = ColumnIndex(file, s["primary"].get<std::string>());
+        if (primary == std::numeric_limits<size_t>::max()) Fail(path + ": no primary column");
+        MappedFile mapped(in_dir + "/" + path);
+        auto text = mapped.Text();
+        auto bounds = SplitLines(text, SkipLines(text, file.value("header", 0)), threads);
+        std::vector<std::vector<int64_t>> ids(threads);
+        std::vector<std::string> errors(threads);
+        ParallelFor(threads, [&](size_t t) {
+            std::vector<std::string_view> fields;
+            ForEachRow(text, bounds[t], bounds[t + 1], {primary}, fields,
+                       [&](std::string_view line, size_t) {
+                           int64_t id;
+                           if (!ParseInt(fields[0], id)) {
+                               if (errors[t].empty()) errors[t] = std::string(line);
+                               return;
+                           }
+                           ids[t].push_back(id);
+                       });
+        });
+        for (auto& e : errors) {
+            if (!e.empty()) Fail(path + ": bad id in row " + e);
+        }
+        auto& m = vids[label];
+        for (auto& chunk : ids) {
+            for (auto id : chunk) {
+                if (m.emplace(id, next_vid).second) next_vid++;
+            }
+        }
+        std::filesystem::copy_file(in_dir + "/" + path, out_dir + "/" + path,
+                                   std::filesystem::copy_options::overwrite_existing);
+        std::printf("%-32s %12zu vertices\n", path.c_str(), m.size());
+    }
+
+    for (auto& file : conf["files"]) {
+        auto label = file["label"].get<std::string>();
+        auto& s = schema.at(label);
+        if (s["type"] != "EDGE") continue;
+        auto path = file["path"].get<std::string>();
+        auto& src_vids = vids[file["SRC_ID"].get<std::string>()];
+        auto& dst_vids = vids[file["DST_ID"].get<std::string>()];
+        bool desc = s.value("tid_order", "") == "desc";
+        size_t src_col = ColumnIndex(file, "SRC_ID"), dst_col = ColumnIndex(file, "DST_ID");
+        size_t ts_col = ColumnIndex(file, s.value("tid", "timestamp"));
+        // ForEachRow wants ascending indexes; remember where each field lands
+        std::vector<size_t> wanted = {src_col, dst_col};
+        if (ts_col != std::numeric_limits<size_t>::max()) wanted.push_back(ts_col);
+        std::vector<size_t> order = wanted;
+        std::sort(wanted.begin(), wanted.end());
+        auto slot = [&](size_t col) {
+            return std::find(wanted.begin(), wanted.end(), col) - wanted.begin();
+        };
+        size_t src_slot = slot(order[0]), dst_slot = slot(order[1]);
+        size_t ts_slot = order.size() > 2 ? slot(order[2]) : wanted.size();
+
+        MappedFile mapped(in_dir + "/" + path);
+        auto text = mapped.Text();
+        size_t body = SkipLines(text, file.value("header", 0));
+        auto bounds = SplitLines(text, body, threads);
+        std::vector<std::vector<EdgeRecord>> records(threads);
+        std::vector<std::string> errors(threads);
+        ParallelFor(threads, [&](size_t t) {
+            std::vector<std::string_view> fields;
+            ForEachRow(text, bounds[t], bounds[t + 1], wanted, fields,
+                       [&](std::string_view line, size_t offset) {
+                           int64_t src, dst, ts = 0;
+                           auto src_vid = src_vids.end(), dst_vid = dst_vids.end();
+                           if (ParseInt(fields[src_slot], src)) src_vid = src_vids.find(src);
+                           if (ParseInt(fields[dst_slot], dst)) dst_vid = dst_vids.find(dst);
+                           if (src_vid == src_vids.end() || dst_vid == dst_vids.end()) {
+                               if (errors[t].empty()) errors[t] = std::string(line);
+                               return;
+                           }
+                           // rows without a numeric timestamp sort as timestamp 0
+                           if (ts_slot < fields.size()) ParseInt(fields[ts_slot], ts);
+                           records[t].push_back({src_vid->second, desc ? -ts : ts, dst_vid->second,
+                                                 offset, (uint32_t)line.size()});
+                       });
+            std::sort(records[t].begin(), records[t].end());
+        });
+        for (auto& e : errors) {
+            if (!e.empty()) Fail(path + ": unknown endpoint in row " + e);
+        }
+        // merge the sorted ranges pairwise, in parallel within each round
+        std::vector<EdgeRecord> all;
+        std::vector<size_t> starts = {0};
+        for (auto& r : records) {
+            all.insert(all.end(), r.begin(), r.end());
+            starts.push_back(all.size());
+            std::vector<EdgeRecord>().swap(r);
+        }
+        while (starts.size() > 2) {
+            std::vector<size_t> merged;
+            size_t pairs = (starts.size() - 1) / 2;
+            ParallelFor(pairs, [&](size_t p) {
+                std::inplace_merge(all.begin() + starts[2 * p], all.begin() + starts[2 * p + 1],
+                                   all.begin() + starts[2 * p + 2]);
+            });
+            for (size_t i = 0; i < starts.size(); i += 2) merged.push_back(starts[i]);
+            if (merged.back() != starts.back()) merged.push_back(starts.back());
+            starts.swap(merged);
+        }
+
+        std::ofstream out(out_dir + "/" + path, std::ios::binary);
+        if (!out) Fail("cannot create " + out_dir + "/" + path);
+        std::vector<char> buffer(1 << 20);
+        out.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+        out.write(text.data(), body);
+        if (body > 0 && text[body - 1] != '\n') out.put('\n');
+        for (auto& r : all) {
+            out.write(text.data() + r.offset, r.length);
+            out.put('\n');
+        }
+        out.close();
+        if (!out) Fail("cannot write " + out_dir + "/" + path);
+        std::printf("%-32s %12zu edges\n", path.c_str(), all.size());
+    }
+    std::printf("done in %.1f s\n", std::chrono::duration<double>(
+                                        std::chrono::steady_clock::now() - begin)
+                                        .count());
+    return 0;
+}
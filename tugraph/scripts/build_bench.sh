@@ -0,0 +1,11 @@
+INCLUDE_DIR="/usr/local/include"
+LIBLGRAPH="/usr/local/lib64/liblgraph.so"
+SCRIPT_DIR=$( cd -- "$( dirname -- "${BASH_SOURCE[0]}" )" &> /dev/null && pwd )
+cd $SCRIPT_DIR/../procedures/bench
+for i in bench_jaccard bench_window; do
+    g++ -g --std=c++17 -I../cpp -O3 -o $i $i.cpp
+done
+# benches that embed the database and dlopen the plugins built by build_procedure.sh
+for i in bench_tcr8_incremental bench_cycle check_tcr8_scratch replay_mixed; do
+    g++ -g --std=c++17 -I../cpp -I$INCLUDE_DIR -O3 -pthread -o $i $i.cpp $LIBLGRAPH -ldl
+done
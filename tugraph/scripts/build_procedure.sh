@@ -2,9 +2,13 @@ INCLUDE_DIR="/usr/local/include"
 LIBLGRAPH="/usr/local/lib64/liblgraph.so"
 SCRIPT_DIR=$( cd -- "$( dirname -- "${BASH_SOURCE[0]}" )" &> /dev/null && pwd )
 cd $SCRIPT_DIR/../procedures/cpp
-for i in trw1 trw2 trw3; do
-    g++ -fno-gnu-unique -fPIC -g --std=c++17 -I$INCLUDE_DIR -rdynamic -O3 -fopenmp -o $i.so $i.cpp $LIBLGRAPH -shared
+# state shared by all plugins lives in one library, loaded once by the server
+RUNTIME_DIR=$(pwd)
+g++ -fno-gnu-unique -fPIC -g --std=c++17 -I$INCLUDE_DIR -O3 -o libfinbench_runtime.so finbench_runtime.cpp -shared
+LIBRUNTIME="-L$RUNTIME_DIR -lfinbench_runtime -Wl,-rpath,$RUNTIME_DIR"
+for i in trw1 trw2 trw3 tw12 tw13 tw15 tw17 tw18 tw19; do
+    g++ -fno-gnu-unique -fPIC -g --std=c++17 -I$INCLUDE_DIR -rdynamic -O3 -fopenmp -o $i.so $i.cpp $LIBLGRAPH $LIBRUNTIME -shared
 done
-for i in tcr8; do
-    g++ -fno-gnu-unique -fPIC -g --std=c++17 -I$INCLUDE_DIR -rdynamic -O3 -fopenmp -o $i.so $i.cpp $LIBLGRAPH -shared
+for i in tcr8 tcr10 tcycle; do
+    g++ -fno-gnu-unique -fPIC -g --std=c++17 -I$INCLUDE_DIR -rdynamic -O3 -fopenmp -o $i.so $i.cpp $LIBLGRAPH $LIBRUNTIME -shared
 done
@@ -0,0 +1,4 @@
+INCLUDE_DIR="/usr/local/include"
+SCRIPT_DIR=$( cd -- "$( dirname -- "${BASH_SOURCE[0]}" )" &> /dev/null && pwd )
+cd $SCRIPT_DIR/../procedures/tools
+g++ -g --std=c++17 -I$INCLUDE_DIR -O3 -o presort_snapshot presort_snapshot.cpp -lpthread -lstdc++fs
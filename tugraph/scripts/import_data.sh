@@ -1,3 +1,11 @@
 SCRIPT_DIR=$( cd -- "$( dirname -- "${BASH_SOURCE[0]}" )" &> /dev/null && pwd )
-cd $SCRIPT_DIR/../data/${1}/snapshot
+SNAPSHOT=$SCRIPT_DIR/../data/${1}/snapshot
+PRESORT=$SCRIPT_DIR/../procedures/tools/presort_snapshot
+# with FINBENCH_PRESORT=1, hand the importer edge files already in storage order
+if [ "${FINBENCH_PRESORT:-0}" = "1" ]; then
+    [ -x $PRESORT ] || { echo "$PRESORT missing, run build_tools.sh" >&2; exit 1; }
+    $PRESORT $SCRIPT_DIR/../data/import.conf $SNAPSHOT $SNAPSHOT.sorted || exit 1
+    SNAPSHOT=$SNAPSHOT.sorted
+fi
+cd $SNAPSHOT
 lgraph_import -c ../../import.conf --overwrite 1 --dir /data/lgraph_db --delimiter "|"
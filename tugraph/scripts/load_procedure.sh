@@ -1,9 +1,16 @@
 ENDPOINT="127.0.0.1:7070"
+# accounts and loans whose adjacency the warm-up reads, 0 (the default) to skip
+WARMUP_TOP=${FINBENCH_WARMUP_TOP:-0}
 SCRIPT_DIR=$( cd -- "$( dirname -- "${BASH_SOURCE[0]}" )" &> /dev/null && pwd )
 cd $SCRIPT_DIR/../procedures/cpp
-for i in trw1 trw2 trw3; do
+for i in trw1 trw2 trw3 tw12 tw13 tw15 tw17 tw18 tw19; do
     python3 install.py $ENDPOINT $i RW
 done
-for i in tcr8; do
+for i in tcr8 tcr10 tcycle; do
     python3 install.py $ENDPOINT $i RO
 done
+# the first warm-up reads the hot adjacency, the others only their own statics
+python3 call.py $ENDPOINT tcr8 "{\"warmup\": {\"top\": $WARMUP_TOP}}"
+for i in trw1 trw2 trw3 tw12 tw13 tw15 tw17 tw18 tw19 tcr10 tcycle; do
+    python3 call.py $ENDPOINT $i '{"warmup": {}}'
+done
@@ -0,0 +1,18 @@
+SCRIPT_DIR=$( cd -- "$( dirname -- "${BASH_SOURCE[0]}" )" &> /dev/null && pwd )
+cd $SCRIPT_DIR/../procedures/bench
+# parses the incremental streams without a database; run build_bench.sh first
+INC_DIR=${1:-testdata/incremental}
+OUT=$(./replay_mixed - $INC_DIR -) || { echo "replay_mixed failed on $INC_DIR" >&2; exit 1; }
+echo "$OUT"
+for kind in trw1 trw2 trw3 tw12 write10; do
+    echo "$OUT" | grep -q "^$kind *parsed [1-9]" || { echo "no $kind parsed" >&2; exit 1; }
+done
+# ReadWrite1 has no truncation column, ReadWrite2 and 3 take theirs
+echo "$OUT" | grep "^trw1 {" | grep -qv '"limit":-1' && { echo "trw1 not untruncated" >&2; exit 1; }
+if [ "$INC_DIR" = "testdata/incremental" ]; then
+    echo "$OUT" | grep -q '^trw2 {.*"limit":100.*"threshold":100.0' ||
+        { echo "trw2 columns" >&2; exit 1; }
+    echo "$OUT" | grep -q '^trw3 {.*"limit":50.*"threshold":0.5' ||
+        { echo "trw3 columns" >&2; exit 1; }
+fi
+echo ok
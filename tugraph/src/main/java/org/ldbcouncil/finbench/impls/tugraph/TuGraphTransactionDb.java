@@ -406,13 +406,12 @@ public class TuGraphTransactionDb extends Db {
                 ResultReporter resultReporter) throws DbException {
             try {
                 TuGraphDbRpcClient client = dbConnectionState.popClient();
-                String cypher = "MATCH (p1:Person {id:%d})-[edge1:invest]->(m1:Company) WHERE edge1.timestamp > %d AND edge1.timestamp < %d WITH collect(distinct id(m1)) as m1_vids MATCH (p2:Person {id:%d})-[edge2:invest]->(m2:Company) WHERE edge2.timestamp > %d AND edge2.timestamp < %d WITH collect(distinct id(m2)) as m2_vids, m1_vids CALL algo.jaccard(m1_vids, m2_vids) YIELD similarity RETURN round(similarity*1000)/1000 AS similarity;";
+                String cypher = "CALL plugin.cpp.tcr10({ pid1: %d, pid2: %d, startTime: %d, endTime: %d });";
                 long startTime = cr10.getStartTime().getTime();
                 long endTime = cr10.getEndTime().getTime();
                 cypher = String.format(
                         cypher,
-                        cr10.getPid1(), startTime, endTime,
-                        cr10.getPid2(), startTime, endTime);
+                        cr10.getPid1(), cr10.getPid2(), startTime, endTime);
                 String graph = "default";
                 String res = client.callCypher(cypher, graph, 0);
                 ArrayList<ComplexRead10Result> results = new ArrayList<>();
@@ -913,7 +912,7 @@ public class TuGraphTransactionDb extends Db {
                 ResultReporter resultReporter) throws DbException {
             try {
                 TuGraphDbRpcClient client = dbConnectionState.popClient();
-                String cypher = "MATCH (a1:Account{id:%d}), (a2:Account{id:%d}) CREATE (a1)-[:transfer{timestamp: %d, amount: %f}]->(a2);";
+                String cypher = "CALL plugin.cpp.tw12({ srcId: %d, dstId: %d, time: %d, amt: %f });";
                 cypher = String.format(
                         cypher,
                         w12.getAccountId1(), w12.getAccountId2(), w12.getTime().getTime(), w12.getAmount());
@@ -933,7 +932,7 @@ public class TuGraphTransactionDb extends Db {
                 ResultReporter resultReporter) throws DbException {
             try {
                 TuGraphDbRpcClient client = dbConnectionState.popClient();
-                String cypher = "MATCH (a1:Account{id:%d}), (a2:Account{id:%d}) CREATE (a1)-[:withdraw{timestamp: %d, amount: %f}]->(a2);";
+                String cypher = "CALL plugin.cpp.tw13({ srcId: %d, dstId: %d, time: %d, amt: %f });";
                 cypher = String.format(
                         cypher,
                         w13.getAccountId1(), w13.getAccountId2(), w13.getTime().getTime(), w13.getAmount());
@@ -973,7 +972,7 @@ public class TuGraphTransactionDb extends Db {
                 ResultReporter resultReporter) throws DbException {
             try {
                 TuGraphDbRpcClient client = dbConnectionState.popClient();
-                String cypher = "MATCH (a:Account{id:%d}), (loan:Loan{id:%d}) CREATE (a)<-[:deposit{timestamp: %d, amount: %f}]-(loan);";
+                String cypher = "CALL plugin.cpp.tw15({ accountId: %d, loanId: %d, time: %d, amt: %f });";
                 cypher = String.format(
                         cypher,
                         w15.getAccountId(), w15.getLoanId(), w15.getTime().getTime(), w15.getAmount());
@@ -1013,7 +1012,7 @@ public class TuGraphTransactionDb extends Db {
                 ResultReporter resultReporter) throws DbException {
             try {
                 TuGraphDbRpcClient client = dbConnectionState.popClient();
-                String cypher = "MATCH (acc:Account {id: %d}) WITH acc OPTIONAL MATCH (acc)-[:repay|deposit]-(loan:Loan) DELETE acc, loan;";
+                String cypher = "CALL plugin.cpp.tw17({ id: %d });";
                 cypher = String.format(
                         cypher,
                         w17.getAccountId());
@@ -1033,7 +1032,7 @@ public class TuGraphTransactionDb extends Db {
                 ResultReporter resultReporter) throws DbException {
             try {
                 TuGraphDbRpcClient client = dbConnectionState.popClient();
-                String cypher = "MATCH (a:Account {id:%d}) SET a.isBlocked = true;";
+                String cypher = "CALL plugin.cpp.tw18({ id: %d });";
                 cypher = String.format(
                         cypher,
                         w18.getAccountId());
@@ -1053,7 +1052,7 @@ public class TuGraphTransactionDb extends Db {
                 ResultReporter resultReporter) throws DbException {
             try {
                 TuGraphDbRpcClient client = dbConnectionState.popClient();
-                String cypher = "MATCH (p:Person {id:%d}) SET p.isBlocked = true;";
+                String cypher = "CALL plugin.cpp.tw19({ id: %d });";
                 cypher = String.format(
                         cypher,
                         w19.getPersonId());